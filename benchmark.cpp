@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "grid.h"
+#include "heston.h"
+#include "lattice.h"
+#include "montecarlo.h"
+#include "pde.h"
+#include "surface.h"
+#include "threadpool.h"
+
+// Microbenchmarks for the pricing core, results as JSON for regression tracking.
+// Each case runs until minTime has elapsed and reports the mean time per unit (option, cell or solve).
+
+namespace {
+
+constexpr int OPTIONS = 4096; // Inputs cycled by the per-option cases
+const int RESOLUTIONS[] = { 100, 200, 400, 800 };
+
+double minTime = 0.25; // Seconds per case
+volatile double sink; // Keeps results observable
+
+struct Inputs {
+    std::vector<double> S, K, r, q, sigma, T;
+    std::vector<double> callPrice, putPrice;
+};
+
+// Random options around the money, optionally restricted to a ln(K/S) and T bucket
+Inputs makeInputs(int n, double minMoneyness, double maxMoneyness, double minT, double maxT, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    Inputs in;
+    for (int i = 0; i < n; ++i) {
+        in.S.push_back(100.0);
+        in.K.push_back(100.0 * std::exp(minMoneyness + (maxMoneyness - minMoneyness) * uniform(generator)));
+        in.r.push_back(0.1 * uniform(generator));
+        in.q.push_back(0.05 * uniform(generator));
+        in.sigma.push_back(0.05 + 0.95 * uniform(generator));
+        in.T.push_back(minT + (maxT - minT) * uniform(generator));
+        in.callPrice.push_back(Functions::computeCallPrice(in.S[i], in.K[i], in.r[i], in.q[i], in.sigma[i], in.T[i]));
+        in.putPrice.push_back(Functions::computePutPrice(in.S[i], in.K[i], in.r[i], in.q[i], in.sigma[i], in.T[i]));
+    }
+    return in;
+}
+
+// Calls run() until minTime has elapsed, run() returns the units it processed. Nanoseconds per unit.
+double measure(const std::function<long long()>& run) {
+    using Clock = std::chrono::steady_clock;
+    run(); // Warm up
+
+    long long units = 0;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        units += run();
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minTime);
+    return elapsed * 1e9 / units;
+}
+
+using Scalar = double (*)(double S, double K, double r, double q, double sigma, double T);
+
+double measureScalar(const Inputs& in, Scalar f) {
+    return measure([&] {
+        double sum = 0;
+        for (int i = 0; i < OPTIONS; ++i)
+            sum += f(in.S[i], in.K[i], in.r[i], in.q[i], in.sigma[i], in.T[i]);
+        sink = sum;
+        return static_cast<long long>(OPTIONS);
+    });
+}
+
+double measureIV(const Inputs& in, bool put) {
+    const std::vector<double>& price = put ? in.putPrice : in.callPrice;
+    return measure([&] {
+        double sum = 0;
+        for (int i = 0; i < static_cast<int>(in.S.size()); ++i)
+            sum += put ? Functions::computePutIV(in.S[i], in.K[i], in.r[i], in.q[i], price[i], in.T[i])
+                       : Functions::computeCallIV(in.S[i], in.K[i], in.r[i], in.q[i], price[i], in.T[i]);
+        sink = sum;
+        return static_cast<long long>(in.S.size());
+    });
+}
+
+// Same sweep ranges as the visualizer's defaults
+Grid::Request makeRequest(Surface::SurfaceMode surfaceMode, Surface::OptionMode mode, Functions::Cdf cdf, bool single, int samples) {
+    const Surface::SurfaceConfig& config = Surface::surfaceMap.at(surfaceMode);
+    const double params[6] = { 100.0, 100.0, 0.05, 0.0, 0.2, 0.5 };
+    const double minValue[6] = { 50.0, 50.0, 0.0, 0.0, 0.05, 1.0 / 365.25 };
+    const double maxValue[6] = { 150.0, 150.0, 0.1, 0.1, 1.0, 2.0 };
+    const std::string axes = "SKRQIT";
+
+    Grid::Request request;
+    request.generation = 1;
+    request.surfaceMode = surfaceMode;
+    request.mode = mode;
+    request.computeZ = config.computeZ;
+    request.computeSurface = config.computeSurface;
+    std::copy(std::begin(params), std::end(params), request.params);
+    request.idx = static_cast<int>(axes.find(config.xVal));
+    request.idy = static_cast<int>(axes.find(config.yVal));
+    request.min_x = minValue[request.idx];
+    request.max_x = maxValue[request.idx];
+    request.min_y = minValue[request.idy];
+    request.max_y = maxValue[request.idy];
+    request.cdf = cdf;
+    request.samples = samples;
+    request.adaptive = false;
+    request.single = single;
+    return request;
+}
+
+const char* modeName(Surface::SurfaceMode mode) {
+    switch (mode) {
+    case Surface::SurfaceMode::SKP: return "SKP";
+    case Surface::SurfaceMode::SIP: return "SIP";
+    case Surface::SurfaceMode::STP: return "STP";
+    case Surface::SurfaceMode::SID: return "SID";
+    case Surface::SurfaceMode::STD: return "STD";
+    case Surface::SurfaceMode::STG: return "STG";
+    case Surface::SurfaceMode::STV: return "STV";
+    case Surface::SurfaceMode::STH: return "STH";
+    case Surface::SurfaceMode::STO: return "STO";
+    case Surface::SurfaceMode::STM: return "STM";
+    case Surface::SurfaceMode::STAP: return "STAP";
+    case Surface::SurfaceMode::STAD: return "STAD";
+    case Surface::SurfaceMode::STAG: return "STAG";
+    case Surface::SurfaceMode::STAH: return "STAH";
+    case Surface::SurfaceMode::KTXP: return "KTXP";
+    }
+    return "?";
+}
+
+// Collects results as a JSON object { "threads", "min_time", "results" }, results an array of
+// { "group", "name", "unit", "value" } records
+class Report
+{
+public:
+    void add(const std::string& group, const std::string& name, const char* unit, double value) {
+        std::fprintf(stderr, "%-10s %-28s %12.6g %s\n", group.c_str(), name.c_str(), value, unit);
+        char line[256];
+        std::snprintf(line, sizeof(line), "    {\"group\": \"%s\", \"name\": \"%s\", \"unit\": \"%s\", \"value\": %.6g}",
+                      group.c_str(), name.c_str(), unit, value);
+        records.push_back(line);
+    }
+
+    void write(FILE* out) const {
+        std::fprintf(out, "{\n  \"threads\": %d,\n  \"min_time\": %g,\n  \"results\": [\n", ThreadPool::instance().size(), minTime);
+        for (size_t i = 0; i < records.size(); ++i)
+            std::fprintf(out, "%s%s\n", records[i].c_str(), i + 1 < records.size() ? "," : "");
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    std::vector<std::string> records;
+};
+
+void benchmarkFunctions(Report& report) {
+    const Inputs in = makeInputs(OPTIONS, -0.5, 0.5, 0.02, 2.0, 1);
+
+    const struct { const char* name; Scalar f; } scalars[] = {
+        { "computeD1", Functions::computeD1 },
+        { "computeCallPrice", Functions::computeCallPrice },
+        { "computePutPrice", Functions::computePutPrice },
+        { "computeCallDelta", Functions::computeCallDelta },
+        { "computePutDelta", Functions::computePutDelta },
+        { "computeGamma", Functions::computeGamma },
+        { "computeVega", Functions::computeVega },
+        { "computeCallTheta", Functions::computeCallTheta },
+        { "computePutTheta", Functions::computePutTheta },
+        { "computeCallRho", Functions::computeCallRho },
+        { "computePutRho", Functions::computePutRho },
+    };
+    for (const auto& scalar : scalars)
+        report.add("functions", scalar.name, "ns/option", measureScalar(in, scalar.f));
+
+    report.add("functions", "computeD2", "ns/option", measureScalar(in, [](double, double, double, double, double sigma, double T) {
+        return Functions::computeD2(sigma, T, 0.1);
+    }));
+    report.add("functions", "computeN", "ns/option", measureScalar(in, [](double, double, double, double, double sigma, double) {
+        return Functions::computeN(sigma - 0.5);
+    }));
+    report.add("functions", "computeN_rational", "ns/option", measureScalar(in, [](double, double, double, double, double sigma, double) {
+        return Functions::computeN(sigma - 0.5, Functions::Cdf::RATIONAL);
+    }));
+    report.add("functions", "computeN_fast", "ns/option", measureScalar(in, [](double, double, double, double, double sigma, double) {
+        return Functions::computeN(sigma - 0.5, Functions::Cdf::FAST);
+    }));
+    // Relative error of the rational N(x) in the far tail, where it switches to the continued fraction
+    double tailError = 0;
+    for (double x = -7.08; x > -37.0; x -= 0.01) {
+        const double exact = 0.5 * std::erfc(-x / std::sqrt(2.0));
+        tailError = std::max(tailError, std::fabs(Functions::computeN(x, Functions::Cdf::RATIONAL) / exact - 1.0));
+    }
+    report.add("functions", "computeN_rational_tail_error", "relative", tailError);
+    report.add("functions", "computeNP", "ns/option", measureScalar(in, [](double, double, double, double, double sigma, double) {
+        return Functions::computeNP(sigma - 0.5);
+    }));
+    report.add("functions", "computeGreeks", "ns/option", measureScalar(in, [](double S, double K, double r, double q, double sigma, double T) {
+        return Functions::computeGreeks(S, K, r, q, sigma, T).putTheta;
+    }));
+    report.add("functions", "computeCallIV", "ns/option", measureIV(in, false));
+    report.add("functions", "computePutIV", "ns/option", measureIV(in, true));
+
+    // Batch entry points, every output requested
+    std::vector<double> out[10];
+    for (auto& values : out)
+        values.resize(OPTIONS);
+    const Functions::BatchInput batchIn = { in.S.data(), in.K.data(), in.r.data(), in.q.data(), in.sigma.data(), in.T.data() };
+    Functions::BatchOutput batchOut;
+    batchOut.callPrice = out[0].data(); batchOut.putPrice = out[1].data();
+    batchOut.callDelta = out[2].data(); batchOut.putDelta = out[3].data();
+    batchOut.gamma = out[4].data(); batchOut.vega = out[5].data();
+    batchOut.callTheta = out[6].data(); batchOut.putTheta = out[7].data();
+    batchOut.callRho = out[8].data(); batchOut.putRho = out[9].data();
+    report.add("functions", "computeBatch", "ns/option", measure([&] {
+        Functions::computeBatch(batchIn, batchOut, OPTIONS);
+        sink = out[0][0];
+        return static_cast<long long>(OPTIONS);
+    }));
+
+    const Functions::IVBatchInput ivIn = { in.S.data(), in.K.data(), in.r.data(), in.q.data(), in.callPrice.data(), in.T.data() };
+    report.add("functions", "computeIVBatch", "ns/option", measure([&] {
+        Functions::computeIVBatch(ivIn, out[0].data(), OPTIONS);
+        sink = out[0][0];
+        return static_cast<long long>(OPTIONS);
+    }));
+}
+
+// Call solves bucketed by ln(K/S) and expiry, the solver's iteration count depends on both
+void benchmarkIV(Report& report) {
+    const struct { const char* name; double lo, hi; } moneyness[] = {
+        { "deep_itm", -1.0, -0.4 }, { "itm", -0.4, -0.1 }, { "atm", -0.1, 0.1 }, { "otm", 0.1, 0.4 }, { "deep_otm", 0.4, 1.0 },
+    };
+    const struct { const char* name; double lo, hi; } expiry[] = {
+        { "1w", 1.0 / 52, 2.0 / 52 }, { "1m", 1.0 / 12, 2.0 / 12 }, { "6m", 0.4, 0.6 }, { "2y", 1.5, 2.5 },
+    };
+
+    for (const auto& m : moneyness)
+        for (const auto& e : expiry) {
+            const Inputs in = makeInputs(1024, m.lo, m.hi, e.lo, e.hi, 2);
+            report.add("iv", std::string(m.name) + "_" + e.name, "ns/solve", measureIV(in, false));
+        }
+}
+
+void benchmarkSurfaces(Report& report) {
+    std::vector<Surface::SurfaceMode> modes;
+    for (const auto& entry : Surface::surfaceMap)
+        modes.push_back(entry.first);
+    std::sort(modes.begin(), modes.end());
+
+    const struct { const char* name; Functions::Cdf cdf; bool single; } backends[] = {
+        { "exact", Functions::Cdf::EXACT, false }, { "rational", Functions::Cdf::RATIONAL, false },
+        { "fast", Functions::Cdf::FAST, false }, { "float", Functions::Cdf::FAST, true },
+    };
+
+    std::atomic<unsigned long long> latest(1);
+    for (Surface::SurfaceMode mode : modes) {
+        // Surfaces without a kernel (computeZ, lattices) ignore the backend, timed once
+        const bool kernel = Kernels::lookup(mode, Surface::OptionMode::CALL, Functions::Cdf::FAST) != nullptr;
+        for (const auto& backend : backends) {
+            if (!kernel && &backend != &backends[0])
+                continue;
+            for (int samples : RESOLUTIONS) {
+                const Grid::Request request = makeRequest(mode, Surface::OptionMode::CALL, backend.cdf, backend.single, samples);
+                Grid::Result result;
+                const double ns = measure([&] {
+                    Grid::evaluate(request, result, latest);
+                    return static_cast<long long>(samples) * samples;
+                });
+                report.add("surface", std::string(modeName(mode)) + "_" + backend.name + "_" + std::to_string(samples), "ns/cell", ns);
+            }
+        }
+    }
+}
+
+// At-the-money calls, 64 monitoring dates, antithetic with the European control (EUROPEAN itself without it),
+// pseudo-random and Sobol.
+// Time per path step and the standard error reached, which together give the cost of a target accuracy.
+void benchmarkMonteCarlo(Report& report) {
+    const struct { const char* name; MonteCarlo::Payoff payoff; double barrier; } payoffs[] = {
+        { "european", MonteCarlo::Payoff::EUROPEAN, 0.0 }, { "asian", MonteCarlo::Payoff::ASIAN, 0.0 },
+        { "up_and_out", MonteCarlo::Payoff::UP_AND_OUT, 120.0 }, { "lookback", MonteCarlo::Payoff::LOOKBACK, 0.0 },
+    };
+    const struct { const char* suffix; MonteCarlo::Sequence sequence; } sequences[] = {
+        { "", MonteCarlo::Sequence::PSEUDO }, { "_sobol", MonteCarlo::Sequence::SOBOL },
+    };
+    const int steps = 64;
+    const long long paths = 1 << 16;
+
+    for (const auto& sequence : sequences) {
+        for (const auto& p : payoffs) {
+            const MonteCarlo::Contract contract = { p.payoff, false, p.barrier, steps };
+            MonteCarlo::Settings settings = { paths, 1, true, true };
+            settings.sequence = sequence.sequence;
+            MonteCarlo::Estimate estimate = {};
+            const double ns = measure([&] {
+                estimate = MonteCarlo::price(100.0, 100.0, 0.05, 0.0, 0.2, 1.0, contract, settings);
+                return estimate.paths * steps;
+            });
+            const std::string name = std::string(p.name) + sequence.suffix;
+            report.add("montecarlo", name, "ns/path-step", ns);
+            report.add("montecarlo", name + "_stderr", "price", estimate.standardError);
+            if (p.payoff == MonteCarlo::Payoff::EUROPEAN) // Simulated without a control, should be within a few stderr
+                report.add("montecarlo", name + "_error", "price", std::fabs(estimate.price - Functions::computeCallPrice(100.0, 100.0, 0.05, 0.0, 0.2, 1.0)));
+        }
+    }
+}
+
+// American puts across the money, every method at a few step counts: time per option and the largest error
+// against a Crank-Nicolson solve on 8000 nodes, which shares no discretisation with the lattices
+void benchmarkLattice(Report& report) {
+    const int count = 16;
+    const double K = 100.0, r = 0.05, q = 0.02, sigma = 0.3, T = 1.0;
+    std::vector<double> S(count);
+    for (int i = 0; i < count; ++i)
+        S[i] = 80.0 + 40.0 * i / (count - 1);
+    std::vector<Pde::Greeks> fine(count);
+    Pde::solve(true, S.data(), count, &T, 1, K, r, q, sigma, { true, 8000, 4000 }, fine.data());
+    std::vector<double> reference(count);
+    for (int i = 0; i < count; ++i)
+        reference[i] = fine[i].price;
+
+    const struct { const char* name; Lattice::Method method; } methods[] = {
+        { "crr", Lattice::Method::CRR }, { "leisen_reimer", Lattice::Method::LEISEN_REIMER }, { "trinomial", Lattice::Method::TRINOMIAL },
+    };
+    for (int steps : { 64, 128, 256 }) {
+        for (const auto& m : methods) {
+            double error = 0;
+            const double ns = measure([&] {
+                error = 0;
+                for (int i = 0; i < count; ++i)
+                    error = std::max(error, std::fabs(Lattice::american(true, S[i], K, r, q, sigma, T, m.method, steps).price - reference[i]));
+                return static_cast<long long>(count);
+            });
+            report.add("lattice", std::string(m.name) + "_" + std::to_string(steps), "ns/option", ns);
+            report.add("lattice", std::string(m.name) + "_" + std::to_string(steps) + "_error", "price", error);
+        }
+    }
+}
+
+// One solve for a 200 x 200 (S, T) put surface, European against the closed form and American against a fine
+// Leisen-Reimer lattice on a sub-grid
+void benchmarkPde(Report& report) {
+    const int count = 200, check = 8;
+    const double K = 100.0, r = 0.05, q = 0.02, sigma = 0.3;
+    std::vector<double> S(count), T(count);
+    for (int i = 0; i < count; ++i) {
+        S[i] = 50.0 + 100.0 * i / (count - 1);
+        T[i] = 0.05 + 1.95 * i / (count - 1);
+    }
+    std::vector<double> reference(count * count, NAN);
+    for (int t = count / (2 * check); t < count; t += count / check) {
+        for (int i = count / (2 * check); i < count; i += count / check)
+            reference[t * count + i] = Lattice::american(true, S[i], K, r, q, sigma, T[t], Lattice::Method::LEISEN_REIMER, 8001).price;
+    }
+
+    std::vector<Pde::Greeks> out(count * count);
+    for (int spaceSteps : { 200, 400, 800 }) {
+        for (bool american : { false, true }) {
+            const Pde::Settings settings{ american, spaceSteps, spaceSteps / 2 };
+            const double ns = measure([&] {
+                Pde::solve(true, S.data(), count, T.data(), count, K, r, q, sigma, settings, out.data());
+                return static_cast<long long>(count) * count;
+            });
+            double error = 0;
+            for (int t = 0; t < count; ++t) {
+                for (int i = 0; i < count; ++i) {
+                    const double exact = american ? reference[t * count + i] : Functions::computePutPrice(S[i], K, r, q, sigma, T[t]);
+                    if (!std::isnan(exact))
+                        error = std::max(error, std::fabs(out[t * count + i].price - exact));
+                }
+            }
+            const std::string name = std::string(american ? "american_" : "european_") + std::to_string(spaceSteps);
+            report.add("pde", name, "ns/cell", ns);
+            report.add("pde", name + "_error", "price", error);
+        }
+    }
+}
+
+// Strips of 1000 put strikes at one expiry: with the characteristic function cached, and evaluated afresh for
+// every strip (a new expiry each time). Errors against 4096 terms, and against the call of Fang & Oosterlee (2008).
+void benchmarkHeston(Report& report) {
+    const int count = 1000;
+    const double S = 100.0, r = 0.03, q = 0.01, T = 0.5;
+    const Heston::Model model{ 0.04, 2.0, 0.04, 0.5, -0.7 };
+    std::vector<double> K(count), reference(count), out(count);
+    for (int i = 0; i < count; ++i)
+        K[i] = 50.0 + 150.0 * i / (count - 1);
+    Heston::strip(true, S, K.data(), count, r, q, T, model, reference.data(), 4096);
+
+    for (int terms : { 64, 128, 256 }) {
+        const std::string name = "strip_" + std::to_string(terms);
+        report.add("heston", name, "ns/quote", measure([&] {
+            Heston::strip(true, S, K.data(), count, r, q, T, model, out.data(), terms);
+            return static_cast<long long>(count);
+        }));
+        double error = 0;
+        for (int i = 0; i < count; ++i)
+            error = std::max(error, std::fabs(out[i] - reference[i]));
+        report.add("heston", name + "_error", "price", error);
+
+        double expiry = T;
+        report.add("heston", name + "_new_expiry", "ns/quote", measure([&] {
+            expiry = std::nextafter(expiry, 1.0); // Misses the cache
+            Heston::strip(true, S, K.data(), count, r, q, expiry, model, out.data(), terms);
+            return static_cast<long long>(count);
+        }));
+    }
+
+    const Heston::Model published{ 0.0175, 1.5768, 0.0398, 0.5751, -0.5711 };
+    report.add("heston", "published_error", "price", std::fabs(Heston::price(false, 100.0, 100.0, 0.0, 0.0, 1.0, published) - 5.785155450));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* outputPath = nullptr;
+    std::string only; // Group filter
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "-t" && i + 1 < argc) {
+            minTime = std::atof(argv[++i]);
+        } else if (arg == "-g" && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            std::fprintf(stderr, "Usage: %s [-o results.json] [-t seconds per case] [-g functions|iv|surface|montecarlo|lattice|pde|heston]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Report report;
+    if (only.empty() || only == "functions")
+        benchmarkFunctions(report);
+    if (only.empty() || only == "iv")
+        benchmarkIV(report);
+    if (only.empty() || only == "surface")
+        benchmarkSurfaces(report);
+    if (only.empty() || only == "montecarlo")
+        benchmarkMonteCarlo(report);
+    if (only.empty() || only == "lattice")
+        benchmarkLattice(report);
+    if (only.empty() || only == "pde")
+        benchmarkPde(report);
+    if (only.empty() || only == "heston")
+        benchmarkHeston(report);
+
+    FILE* out = outputPath ? std::fopen(outputPath, "w") : stdout;
+    if (!out) {
+        std::perror(outputPath);
+        return 1;
+    }
+    report.write(out);
+    if (outputPath)
+        std::fclose(out);
+    return 0;
+}
@@ -4,6 +4,8 @@ constexpr int WIDGET_WIDTH = 125;
 constexpr int WIDGET_WIDTH_DOUBLE = WIDGET_WIDTH * 2 + 6; // Count 6 pixel gap
 constexpr int MENU_WIDTH = 150;
 
+constexpr int INIT_RESOLUTION = 200;
+
 constexpr double INIT_MIN_STOCK_PRICE = 100.0;
 constexpr double INIT_MAX_STOCK_PRICE = 200.0;
 constexpr double INIT_MIN_STRIKE_PRICE = 150.0;
@@ -67,6 +69,13 @@ void Component::setConfig(Surface::SurfaceConfig config) {
 
 }
 
+bool Component::sliderDown() const {
+    for (const QSlider* slider : findChildren<QSlider*>()) // Includes RangeSliders
+        if (slider->isSliderDown())
+            return true;
+    return false;
+}
+
 void Component::setupUI() {
     setupPlot();
     setupMenu();
@@ -457,6 +466,32 @@ void Component::setupMenu() {
     m_button_STM->setMinimumWidth(MENU_WIDTH);
     m_button_STM->setMaximumWidth(MENU_WIDTH);
 
+    m_button_STAP = new QPushButton("(S,T) -> Am. Price", this);
+    m_button_STAP->setCheckable(true);
+    m_button_STAP->setMinimumWidth(MENU_WIDTH);
+    m_button_STAP->setMaximumWidth(MENU_WIDTH);
+
+    m_button_STAD = new QPushButton("(S,T) -> Am. Delta", this);
+    m_button_STAD->setCheckable(true);
+    m_button_STAD->setMinimumWidth(MENU_WIDTH);
+    m_button_STAD->setMaximumWidth(MENU_WIDTH);
+
+    m_button_STAG = new QPushButton("(S,T) -> Am. Gamma", this);
+    m_button_STAG->setCheckable(true);
+    m_button_STAG->setMinimumWidth(MENU_WIDTH);
+    m_button_STAG->setMaximumWidth(MENU_WIDTH);
+
+    m_button_STAH = new QPushButton("(S,T) -> Am. Theta", this);
+    m_button_STAH->setCheckable(true);
+    m_button_STAH->setMinimumWidth(MENU_WIDTH);
+    m_button_STAH->setMaximumWidth(MENU_WIDTH);
+
+    m_button_KTXP = new QPushButton("(K,T) -> Heston", this);
+    m_button_KTXP->setCheckable(true);
+    m_button_KTXP->setToolTip(QString::fromUtf8(u8"Heston stochastic volatility price, \u03C3 as the initial and long-run volatility"));
+    m_button_KTXP->setMinimumWidth(MENU_WIDTH);
+    m_button_KTXP->setMaximumWidth(MENU_WIDTH);
+
     m_buttonGroup = new QButtonGroup(this);
     m_buttonGroup->setExclusive(true);
     m_buttonGroup->addButton(m_button_SKP, static_cast<int>(Surface::SurfaceMode::SKP));
@@ -469,6 +504,38 @@ void Component::setupMenu() {
     m_buttonGroup->addButton(m_button_STH, static_cast<int>(Surface::SurfaceMode::STH));
     m_buttonGroup->addButton(m_button_STO, static_cast<int>(Surface::SurfaceMode::STO));
     m_buttonGroup->addButton(m_button_STM, static_cast<int>(Surface::SurfaceMode::STM));
+    m_buttonGroup->addButton(m_button_STAP, static_cast<int>(Surface::SurfaceMode::STAP));
+    m_buttonGroup->addButton(m_button_STAD, static_cast<int>(Surface::SurfaceMode::STAD));
+    m_buttonGroup->addButton(m_button_STAG, static_cast<int>(Surface::SurfaceMode::STAG));
+    m_buttonGroup->addButton(m_button_STAH, static_cast<int>(Surface::SurfaceMode::STAH));
+    m_buttonGroup->addButton(m_button_KTXP, static_cast<int>(Surface::SurfaceMode::KTXP));
+
+    m_resolutionTitle = new QLabel("Resolution", this);
+    m_resolutionTitle->setAlignment(Qt::AlignCenter);
+
+    m_combo_resolution = new QComboBox(this);
+    for (int samples : {50, 100, 200, 400, 800, 1600})
+        m_combo_resolution->addItem(QString("%1 x %1").arg(samples), samples);
+    m_combo_resolution->setCurrentIndex(m_combo_resolution->findData(INIT_RESOLUTION));
+    m_combo_resolution->setMinimumWidth(MENU_WIDTH);
+    m_combo_resolution->setMaximumWidth(MENU_WIDTH);
+
+    m_check_adaptive = new QCheckBox("Adaptive", this);
+    m_check_adaptive->setToolTip("Only evaluate cells where the surface curves, interpolate the rest");
+
+    m_combo_cdf = new QComboBox(this);
+    m_combo_cdf->addItem("Fast N(x)", static_cast<int>(Functions::Cdf::FAST));
+    m_combo_cdf->addItem("Rational N(x)", static_cast<int>(Functions::Cdf::RATIONAL));
+    m_combo_cdf->addItem("Exact N(x)", static_cast<int>(Functions::Cdf::EXACT));
+    m_combo_cdf->setToolTip("Normal CDF used by the surface: fast (7.5e-8), rational (5e-14) or exact erfc");
+    m_combo_cdf->setMinimumWidth(MENU_WIDTH);
+    m_combo_cdf->setMaximumWidth(MENU_WIDTH);
+
+    m_check_single = new QCheckBox("Single precision", this);
+    m_check_single->setToolTip("Evaluate in float with the fast N(x), falls back to double if a sampled check is off by more than 1e-4 of the range");
+
+    m_check_robust = new QCheckBox("Robust color scale", this);
+    m_check_robust->setToolTip("Scale colors to the 1st-99th percentile instead of the full range");
 
     m_leftLayout = new QVBoxLayout();
     m_leftLayout->addWidget(m_menuTitle);
@@ -482,6 +549,17 @@ void Component::setupMenu() {
     m_leftLayout->addWidget(m_button_STH);
     m_leftLayout->addWidget(m_button_STO);
     m_leftLayout->addWidget(m_button_STM);
+    m_leftLayout->addWidget(m_button_STAP);
+    m_leftLayout->addWidget(m_button_STAD);
+    m_leftLayout->addWidget(m_button_STAG);
+    m_leftLayout->addWidget(m_button_STAH);
+    m_leftLayout->addWidget(m_button_KTXP);
+    m_leftLayout->addWidget(m_resolutionTitle);
+    m_leftLayout->addWidget(m_combo_resolution);
+    m_leftLayout->addWidget(m_check_adaptive);
+    m_leftLayout->addWidget(m_combo_cdf);
+    m_leftLayout->addWidget(m_check_single);
+    m_leftLayout->addWidget(m_check_robust);
     m_leftLayout->addStretch();
 }
 
@@ -6,6 +6,8 @@
 #include <QLabel>
 #include <QVBoxLayout>
 #include <QPushButton>
+#include <QComboBox>
+#include <QCheckBox>
 #include "qcustomplot.h"
 #include "rangeslider.h"
 #include "surface.h"
@@ -41,6 +43,9 @@ public:
     // Set UI visibility based on surface config
     void setConfig(Surface::SurfaceConfig config);
 
+    // True while any slider handle is being dragged
+    bool sliderDown() const;
+
     // Plot
     QCustomPlot* plot() const { return m_plot; }
     QCPColorMap* colorMap() const { return m_colorMap; }
@@ -49,6 +54,11 @@ public:
     // Left-Hand Menu
     QPushButton* toggle_CP() const { return m_toggle_CP; }
     QButtonGroup* buttonGroup() const { return m_buttonGroup; }
+    QComboBox* combo_resolution() const { return m_combo_resolution; } // Item data holds the sample count
+    QCheckBox* check_adaptive() const { return m_check_adaptive; }
+    QComboBox* combo_cdf() const { return m_combo_cdf; } // Item data holds the Functions::Cdf
+    QCheckBox* check_single() const { return m_check_single; }
+    QCheckBox* check_robust() const { return m_check_robust; }
 
     // User-Input Variables
     QSlider* slider_S() const { return m_slider_S; }
@@ -107,7 +117,18 @@ private:
     QPushButton* m_button_STH;
     QPushButton* m_button_STO;
     QPushButton* m_button_STM;
+    QPushButton* m_button_STAP;
+    QPushButton* m_button_STAD;
+    QPushButton* m_button_STAG;
+    QPushButton* m_button_STAH;
+    QPushButton* m_button_KTXP;
     QButtonGroup* m_buttonGroup;
+    QLabel* m_resolutionTitle;
+    QComboBox* m_combo_resolution;
+    QCheckBox* m_check_adaptive;
+    QComboBox* m_combo_cdf;
+    QCheckBox* m_check_single;
+    QCheckBox* m_check_robust;
 
     // Plot
     QCustomPlot* m_plot;
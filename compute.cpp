@@ -1,9 +1,14 @@
 #include "compute.h"
+#include <QGuiApplication>
+#include <QScreen>
 
 Compute::Compute(Component& ui) :
     ui(ui),
     surfaceMode(Surface::SurfaceMode::STP),
     config(Surface::surfaceMap[surfaceMode]),
+    generation(0),
+    dirty(false), recomputeRequests(0), recomputeDispatches(0),
+    cache(CACHE_BUDGET),
     S(0), min_S(0), max_S(0),
     K(0), min_K(0), max_K(0),
     r(0), min_r(0), max_r(0),
@@ -12,6 +17,20 @@ Compute::Compute(Component& ui) :
     T(0), min_T(0), max_T(0),
     d1(0), d2(0), Nd1(0), Nd2(0), C(0), P(0), price(0)
 {
+    worker.setMaxThreadCount(1);
+
+    // One dispatch per display frame, changes arriving inside a frame collapse into the next one
+    const qreal refreshRate = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60.0;
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    frameTimer.setInterval(qMax(1, qRound(1000.0 / qMax<qreal>(refreshRate, 1.0))));
+    QObject::connect(&frameTimer, &QTimer::timeout, this, [this] {
+        if (!dirty)
+            return;
+        dispatch();
+        frameTimer.start();
+    });
+
     // Recompute on update
     QObject::connect(ui.buttonGroup(), &QButtonGroup::idClicked, &ui, [this](int id) {
         surfaceMode = static_cast<Surface::SurfaceMode>(id);
@@ -21,6 +40,14 @@ Compute::Compute(Component& ui) :
     });
 
     QObject::connect(ui.toggle_CP(), &QPushButton::toggled, [this]{recompute();});
+    QObject::connect(ui.combo_resolution(), QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]{recompute();});
+    QObject::connect(ui.check_adaptive(), &QCheckBox::toggled, this, [this]{recompute();});
+    QObject::connect(ui.combo_cdf(), QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]{recompute();});
+    QObject::connect(ui.check_single(), &QCheckBox::toggled, this, [this]{recompute();});
+    QObject::connect(ui.check_robust(), &QCheckBox::toggled, this, [this]{
+        if (shown)
+            show(shown); // Display only, the statistics come with the result
+    });
 
     bindLog(ui.slider_S(), ui.spin_S(), Component::minLimit_S, Component::maxLimit_S);
     bindRangeLog(ui.rangeSlider_S(), ui.spinMin_S(), ui.spinMax_S(), Component::minLimit_S, Component::maxLimit_S);
@@ -43,7 +70,31 @@ Compute::Compute(Component& ui) :
     recompute();
 }
 
+Compute::~Compute() {
+    ++generation; // Cancel any in-flight grid
+    worker.waitForDone();
+
+    qInfo("Compute: %llu recompute requests, %llu dispatched, %llu collapsed",
+          recomputeRequests, recomputeDispatches, recomputeRequests - recomputeDispatches);
+    qInfo("Compute: %llu grid terms resampled, %llu reused", terms.resampled, terms.reused);
+}
+
 void Compute::recompute() {
+    ++recomputeRequests;
+    if (frameTimer.isActive()) {
+        dirty = true; // In-flight work is cancelled by the next dispatch, once per frame
+        return;
+    }
+
+    // Idle: dispatch immediately and hold further changes until the frame ends
+    dispatch();
+    frameTimer.start();
+}
+
+void Compute::dispatch() {
+    ++recomputeDispatches;
+    dirty = false;
+
     Surface::OptionMode mode = ui.toggle_CP()->isChecked() ? Surface::OptionMode::PUT : Surface::OptionMode::CALL;
 
     // Variables
@@ -93,30 +144,84 @@ void Compute::recompute() {
     case 'T': idy = 5, min_y = min_T, max_y = max_T; break;
     }
 
-    double delta_x = (max_x - min_x) / (SAMPLES - 1);
-    double delta_y = (max_y - min_y) / (SAMPLES - 1);
+    Grid::Request request;
+    request.generation = ++generation;
+    request.surfaceMode = surfaceMode;
+    request.mode = mode;
+    request.computeZ = config.computeZ;
+    request.computeSurface = config.computeSurface;
+    std::copy(std::begin(params), std::end(params), request.params);
+    request.idx = idx;
+    request.idy = idy;
+    request.min_x = min_x;
+    request.max_x = max_x;
+    request.min_y = min_y;
+    request.max_y = max_y;
+    request.cdf = static_cast<Functions::Cdf>(ui.combo_cdf()->currentData().toInt());
+    request.samples = ui.combo_resolution()->currentData().toInt();
+    request.adaptive = ui.check_adaptive()->isChecked();
+    request.single = ui.check_single()->isChecked();
+
+    // Flipping back to a surface seen recently needs no evaluation
+    const SurfaceCache::Key key = SurfaceCache::keyOf(request);
+    if (std::shared_ptr<const Grid::Result> cached = cache.find(key)) {
+        show(cached);
+        return;
+    }
 
-    QCPColorMapData *mapData = ui.colorMap()->data();
-    mapData->setSize(SAMPLES, SAMPLES);
-    mapData->setRange(QCPRange(min_x, max_x), QCPRange(min_y, max_y));
-
-    for (int x = 0; x < SAMPLES; ++x) {
-        params[idx] = min_x + x * delta_x;
-        for (int y = 0; y < SAMPLES; ++y) {
-            params[idy] = min_y + y * delta_y;
-            price = config.computeZ(mode, params[0], params[1], params[2], params[3], params[4], params[5]);
-            mapData->setCell(x, y, price);
+    // While dragging, publish coarse passes first and refine, reusing the coarser samples
+    const bool progressive = !request.adaptive && ui.sliderDown();
+
+    // Stale requests still queued behind a running one bail out on their first tile
+    worker.start([this, request, key, progressive] {
+        Grid::Result result;
+        if (!progressive) {
+            if (!Grid::evaluate(request, result, generation, &terms))
+                return;
+        } else {
+            int known = 0;
+            for (int stride = Grid::coarsestStride(request.samples); stride > 1; known = stride, stride /= 2) {
+                if (!Grid::evaluatePass(request, result, stride, known, generation, &terms))
+                    return;
+                QMetaObject::invokeMethod(this, [this, partial = std::make_shared<const Grid::Result>(result)] { publish(partial); }, Qt::QueuedConnection);
+            }
+            if (!Grid::evaluatePass(request, result, 1, known, generation, &terms))
+                return;
         }
-    }
 
-    ui.toggle_CP()->setText(mode == Surface::OptionMode::PUT ? "Mode: Puts" : "Mode: Calls");
-    ui.colorScale()->axis()->setLabel(config.zLabel);
-    ui.colorMap()->rescaleDataRange(true);
-    ui.plot()->xAxis->setLabel(config.xLabel);
-    ui.plot()->yAxis->setLabel(config.yLabel);
-    ui.plot()->xAxis->setRange(min_x, max_x);
-    ui.plot()->yAxis->setRange(min_y, max_y);
-    ui.plot()->replot();
+        auto finished = std::make_shared<const Grid::Result>(std::move(result));
+        cache.insert(key, finished);
+        QMetaObject::invokeMethod(this, [this, finished] { publish(finished); }, Qt::QueuedConnection);
+    });
+}
+
+void Compute::publish(const std::shared_ptr<const Grid::Result>& result) {
+    if (result->request.generation != generation)
+        return; // Superseded while queued
+    show(result);
+}
+
+void Compute::show(const std::shared_ptr<const Grid::Result>& result) {
+    const Grid::Request& request = result->request;
+    const int n = request.samples;
+
+    // The map reads z in place (same row-major layout) and keeps the result alive while shown
+    QCPColorMapData *mapData = ui.colorMap()->data();
+    const Grid::Range& range = result->range;
+    mapData->setSharedData(n, n, std::shared_ptr<const double>(result, result->z.data()), QCPRange(range.min, range.max));
+    mapData->setRange(QCPRange(request.min_x, request.max_x), QCPRange(request.min_y, request.max_y));
+    shown = result;
+
+    ui.toggle_CP()->setText(request.mode == Surface::OptionMode::PUT ? "Mode: Puts" : "Mode: Calls");
+    ui.colorScale()->axis()->setLabel(QString::fromUtf8(config.zLabel));
+    // Scale from the statistics gathered during evaluation, the robust one clips outliers such as theta near expiry
+    const bool robust = ui.check_robust()->isChecked() && range.high > range.low;
+    ui.colorMap()->setDataRange(robust ? QCPRange(range.low, range.high) : QCPRange(range.min, range.max));
+    ui.plot()->xAxis->setLabel(QString::fromUtf8(config.xLabel));
+    ui.plot()->yAxis->setLabel(QString::fromUtf8(config.yLabel));
+    ui.plot()->xAxis->setRange(request.min_x, request.max_x);
+    ui.plot()->yAxis->setRange(request.min_y, request.max_y);
+    ui.plot()->replot(QCustomPlot::rpQueuedReplot); // Several passes published in one event loop turn draw once
 }
 
 void Compute::bindLinear(QSlider* slider, QDoubleSpinBox* spin, double min, double max) {
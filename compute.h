@@ -2,8 +2,14 @@
 #define COMPUTEE_H
 
 #include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
 #include "component.h"
 #include "surface.h"
+#include "grid.h"
+#include "surfacecache.h"
 
 class Compute : public QObject
 {
@@ -11,11 +17,13 @@ class Compute : public QObject
 
 public:
     explicit Compute(Component& ui);
+    ~Compute();
 
 private:
-    static constexpr int SAMPLES = 200;
-
-    void recompute();
+    void recompute(); // Marks the surface dirty, dispatches at most once per display frame
+    void dispatch(); // Snapshots the UI and queues a background grid evaluation
+    void publish(const std::shared_ptr<const Grid::Result>& result); // Shows a grid from the worker unless it has been superseded
+    void show(const std::shared_ptr<const Grid::Result>& result); // Hands a grid to the plot without copying (GUI thread)
     void setUI(Surface::SurfaceConfig config); // Updates active UI
     void bindLinear(QSlider* slider, QDoubleSpinBox* spin, double min, double max); // Binds a slider to a spin box linearly
     void bindRangeLinear(RangeSlider* slider, QDoubleSpinBox* spinMin, QDoubleSpinBox* spinMax, double min, double max);
@@ -26,6 +34,22 @@ private:
     Surface::SurfaceMode surfaceMode;
     Surface::SurfaceConfig config;
 
+    // Background evaluation
+    QThreadPool worker; // Single thread, requests run in order
+    std::atomic<unsigned long long> generation; // Latest issued request
+    Grid::TermCache terms; // Worker thread only, carries sampled terms between requests
+    std::shared_ptr<const Grid::Result> shown; // Surface on screen, redrawn when only the colour scale changes
+
+    // Recompute coalescing
+    QTimer frameTimer; // Runs for one display frame after each dispatch
+    bool dirty; // A recompute arrived while frameTimer was running
+    unsigned long long recomputeRequests;
+    unsigned long long recomputeDispatches;
+
+    // Finished surfaces, so call/put and mode flips skip evaluation
+    static constexpr size_t CACHE_BUDGET = 256u * 1024 * 1024;
+    SurfaceCache cache;
+
     // Stock Price
     double S;
     double min_S;
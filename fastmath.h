@@ -0,0 +1,246 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Runtime dispatch of vectorized loops (ifunc, ELF + GCC only)
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__ELF__)
+#define BATCH_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define BATCH_TARGETS
+#endif
+
+// Helpers must inline into the calling loop for it to vectorize
+#if defined(__GNUC__)
+#define BATCH_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define BATCH_INLINE __forceinline
+#else
+#define BATCH_INLINE inline
+#endif
+
+// Branch-free exp, log and normal CDF for loops the compiler should vectorize (batch pricing, surface rows)
+class FastMath
+{
+public:
+    static constexpr double INV_SQRT_2PI = 0.3989422804014327;
+    static constexpr double LN2_HI = 6.93147180369123816490e-01;
+    static constexpr double LN2_LO = 1.90821492927058770002e-10;
+    static constexpr double LOG2E = 1.4426950408889634074;
+
+    // exp(x) = 2^k * exp(r), |r| <= ln2/2, Taylor to degree 13
+    static BATCH_INLINE double exp(double x) {
+        x = std::min(std::max(x, -708.0), 709.0);
+        const double shift = 0x1.8p52; // Rounds k to nearest and leaves it in the low mantissa bits
+        const double kd = x * LOG2E + shift;
+        const double k = kd - shift;
+        const double r = (x - k * LN2_HI) - k * LN2_LO;
+
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        return p * fromBits((toBits(kd) + 1023) << 52);
+    }
+
+    // log(x) = e*ln2 + log(m), m in [sqrt(1/2), sqrt(2)), log(m) = 2*atanh((m-1)/(m+1)). Positive normal x only.
+    static BATCH_INLINE double log(double x) {
+        const uint64_t bits = toBits(x);
+        double m = fromBits((bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull);
+        double e = fromBits((bits >> 52) | 0x4330000000000000ull) - (0x1p52 + 1023.0);
+
+        const bool high = m > 1.4142135623730951;
+        const double mHalf = m * 0.5;
+        const double eNext = e + 1.0;
+        m = high ? mHalf : m;
+        e = high ? eNext : e;
+
+        const double f = (m - 1.0) / (m + 1.0);
+        const double f2 = f * f;
+        double s = 1.0 / 23.0;
+        s = s * f2 + 1.0 / 21.0;
+        s = s * f2 + 1.0 / 19.0;
+        s = s * f2 + 1.0 / 17.0;
+        s = s * f2 + 1.0 / 15.0;
+        s = s * f2 + 1.0 / 13.0;
+        s = s * f2 + 1.0 / 11.0;
+        s = s * f2 + 1.0 / 9.0;
+        s = s * f2 + 1.0 / 7.0;
+        s = s * f2 + 1.0 / 5.0;
+        s = s * f2 + 1.0 / 3.0;
+
+        return e * LN2_HI + (2.0 * f + 2.0 * f * f2 * s + e * LN2_LO);
+    }
+
+    // N(x) and N(-x) from one Hart (1968) rational approximation, as given by West (2005)
+    static BATCH_INLINE void normal(double x, double& Nx, double& Nmx) {
+        const double a = std::abs(x);
+        const double e = exp(-0.5 * a * a);
+
+        double num = 3.52624965998911e-02;
+        num = num * a + 0.700383064443688;
+        num = num * a + 6.37396220353165;
+        num = num * a + 33.912866078383;
+        num = num * a + 112.079291497871;
+        num = num * a + 221.213596169931;
+        num = num * a + 220.206867912376;
+
+        double den = 8.83883476483184e-02;
+        den = den * a + 1.75566716318264;
+        den = den * a + 16.064177579207;
+        den = den * a + 86.7807322029461;
+        den = den * a + 296.564248779674;
+        den = den * a + 637.333633378831;
+        den = den * a + 793.826512519948;
+        den = den * a + 440.413735824752;
+
+        // Continued fraction for the far tail, folded from the innermost term out
+        double cf = a + 0.65;
+        cf = a + 4.0 / cf;
+        cf = a + 3.0 / cf;
+        cf = a + 2.0 / cf;
+        cf = a + 1.0 / cf;
+
+        const double nearTail = e * num / den;
+        const double farTail = e * INV_SQRT_2PI / cf;
+        double tail = a < 7.07106781186547 ? nearTail : farTail;
+        tail = a > 37.0 ? 0.0 : tail;
+
+        const double body = 1.0 - tail;
+        Nx = x > 0.0 ? body : tail;
+        Nmx = x > 0.0 ? tail : body;
+    }
+
+    // N(x) and N(-x) from Abramowitz & Stegun 26.2.17, |error| < 7.5e-8
+    static BATCH_INLINE void normalFast(double x, double& Nx, double& Nmx) {
+        const double a = std::abs(x);
+        const double t = 1.0 / (1.0 + 0.2316419 * a);
+
+        double poly = 1.330274429;
+        poly = poly * t - 1.821255978;
+        poly = poly * t + 1.781477937;
+        poly = poly * t - 0.356563782;
+        poly = poly * t + 0.319381530;
+
+        const double tail = INV_SQRT_2PI * exp(-0.5 * a * a) * t * poly;
+        const double body = 1.0 - tail;
+        Nx = x > 0.0 ? body : tail;
+        Nmx = x > 0.0 ? tail : body;
+    }
+
+    // Inverse of N for u in (0, 1), Acklam's rational approximations with the tail branch as a select,
+    // relative error < 1.15e-9 (Monte Carlo normals)
+    static BATCH_INLINE double inverseNormal(double u) {
+        const double q = u - 0.5;
+        const double r = q * q;
+        double num = -3.969683028665376e+01;
+        num = num * r + 2.209460984245205e+02;
+        num = num * r - 2.759285104469687e+02;
+        num = num * r + 1.383577518672690e+02;
+        num = num * r - 3.066479806614716e+01;
+        num = num * r + 2.506628277459239e+00;
+        double den = -5.447609879822406e+01;
+        den = den * r + 1.615858368580409e+02;
+        den = den * r - 1.556989798598866e+02;
+        den = den * r + 6.680131188771972e+01;
+        den = den * r - 1.328068155288572e+01;
+        den = den * r + 1.0;
+        const double central = q * num / den;
+
+        const double p = std::min(u, 1.0 - u);
+        const double t = std::sqrt(-2.0 * log(p));
+        double tailNum = -7.784894002430293e-03;
+        tailNum = tailNum * t - 3.223964580411365e-01;
+        tailNum = tailNum * t - 2.400758277161838e+00;
+        tailNum = tailNum * t - 2.549732539343734e+00;
+        tailNum = tailNum * t + 4.374664141464968e+00;
+        tailNum = tailNum * t + 2.938163982698783e+00;
+        double tailDen = 7.784695709041462e-03;
+        tailDen = tailDen * t + 3.224671290700398e-01;
+        tailDen = tailDen * t + 2.445134137142996e+00;
+        tailDen = tailDen * t + 3.754408661907416e+00;
+        tailDen = tailDen * t + 1.0;
+        const double lowerTail = tailNum / tailDen;
+        const double tail = q < 0.0 ? lowerTail : -lowerTail;
+
+        return p < 0.02425 ? tail : central;
+    }
+
+    // Single precision versions, twice the lanes per vector, for surfaces that only feed a color map
+
+    // exp(x) = 2^k * exp(r), |r| <= ln2/2, Taylor to degree 6 (Cody-Waite split of ln2)
+    static BATCH_INLINE float exp(float x) {
+        x = std::min(std::max(x, -87.0f), 88.0f);
+        const float shift = 0x1.8p23f;
+        const float kf = x * 1.44269504f + shift;
+        const float k = kf - shift;
+        const float r = (x - k * 0.693359375f) + k * 2.12194440e-4f;
+
+        float p = 1.0f / 720.0f;
+        p = p * r + 1.0f / 120.0f;
+        p = p * r + 1.0f / 24.0f;
+        p = p * r + 1.0f / 6.0f;
+        p = p * r + 0.5f;
+        p = p * r + 1.0f;
+        p = p * r + 1.0f;
+
+        return p * fromBits32((toBits32(kf) + 127) << 23);
+    }
+
+    static BATCH_INLINE void normalFast(float x, float& Nx, float& Nmx) {
+        const float a = std::abs(x);
+        const float t = 1.0f / (1.0f + 0.2316419f * a);
+
+        float poly = 1.330274429f;
+        poly = poly * t - 1.821255978f;
+        poly = poly * t + 1.781477937f;
+        poly = poly * t - 0.356563782f;
+        poly = poly * t + 0.319381530f;
+
+        const float tail = static_cast<float>(INV_SQRT_2PI) * exp(-0.5f * a * a) * t * poly;
+        const float body = 1.0f - tail;
+        Nx = x > 0.0f ? body : tail;
+        Nmx = x > 0.0f ? tail : body;
+    }
+
+private:
+    static BATCH_INLINE float fromBits32(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof value);
+        return value;
+    }
+
+    static BATCH_INLINE uint32_t toBits32(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        return bits;
+    }
+
+    static BATCH_INLINE double fromBits(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof value);
+        return value;
+    }
+
+    static BATCH_INLINE uint64_t toBits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        return bits;
+    }
+};
+
+#endif // FASTMATH_H
@@ -1,4 +1,5 @@
 #include "functions.h"
+#include "fastmath.h"
 #include <cmath>
 #include <algorithm>
 
@@ -97,50 +98,216 @@ double Functions::computePutRho(double S, double K, double r, double q, double s
     return -K * T * std::exp(-r*T) * computeN(-d2);
 }
 
-double Functions::computeCallIV(double S, double K, double r, double q, double MP, double T) {
-    const int MAX_ITERATIONS = 100;
-    const double TOLERANCE = 1e-8;
+// N(x) and N(-x) from one erfc call, the smaller of the two is evaluated directly
+static void computeNPair(double x, double& Nx, double& Nmx) {
+    const double tail = 0.5 * std::erfc(std::abs(x) / std::sqrt(2));
+    Nx = x > 0 ? 1.0 - tail : tail;
+    Nmx = x > 0 ? tail : 1.0 - tail;
+}
 
-    double sigma = 0.2; // Initial Guess
-    double price, vega, diff;
+Functions::Greeks Functions::computeGreeks(double S, double K, double r, double q, double sigma, double T) {
+    const double sqrtT = std::sqrt(T);
+    const double discQ = std::exp(-q*T);
+    const double discR = std::exp(-r*T);
+    const double d1 = computeD1(S, K, r, q, sigma, T);
+    const double d2 = d1 - sigma*sqrtT;
+    const double NPd1 = computeNP(d1);
+
+    double Nd1, Nmd1, Nd2, Nmd2;
+    computeNPair(d1, Nd1, Nmd1);
+    computeNPair(d2, Nd2, Nmd2);
+
+    const double decay = - (S * NPd1 * sigma * discQ) / (2 * sqrtT); // Shared theta term
+
+    Greeks greeks;
+    greeks.callPrice = S*discQ*Nd1 - K*discR*Nd2;
+    greeks.putPrice = K*discR*Nmd2 - S*discQ*Nmd1;
+    greeks.callDelta = discQ * Nd1;
+    greeks.putDelta = -discQ * Nmd1;
+    greeks.gamma = discQ * NPd1 / (S * sigma * sqrtT);
+    greeks.vega = S * discQ * NPd1 * sqrtT;
+    greeks.callTheta = decay + q*S*discQ*Nd1 - r*K*discR*Nd2;
+    greeks.putTheta = decay - q*S*discQ*Nmd1 + r*K*discR*Nmd2;
+    greeks.callRho = K * T * discR * Nd2;
+    greeks.putRho = -K * T * discR * Nmd2;
+    return greeks;
+}
 
-    for (int i = 0; i < MAX_ITERATIONS; i++) {
-        price = computeCallPrice(S, K, r, q, sigma, T);
-        vega = computeVega(S, K, r, q, sigma, T);
-        diff = price - MP;
+// Normalized Black call b(x, s) = e^(x/2) N(x/s + s/2) - e^(-x/2) N(x/s - s/2), price / sqrt(F*K), x = ln(F/K), s = sigma*sqrt(T)
+static double normalizedCall(double x, double s) {
+    return std::exp(0.5*x) * Functions::computeN(x/s + 0.5*s) - std::exp(-0.5*x) * Functions::computeN(x/s - 0.5*s);
+}
+
+// Solves b(x, s) = beta for s with x <= 0 (out of the money). The inflection point s = sqrt(2|x|) splits the
+// domain: above it the guess is Brenner-Subrahmanyam and steps act on b, below it b vanishes faster than any
+// power so both the guess and the steps act on 1/ln b. Third order Householder steps, kept inside the bracket.
+static double normalizedIV(double x, double beta) {
+    const int MAX_ITERATIONS = 20;
+    const double SQRT_2PI = 2.5066282746310002;
+
+    if (!(beta > 0) || !(beta < std::exp(0.5*x)))
+        return NAN; // Below intrinsic or above the forward, no volatility reproduces it
 
-        if (std::abs(diff) < TOLERANCE)
-            break;
-        if (vega < 1e-12 * std::max(1.0, S)) // Scaled tolerance
-            return NAN;
+    // b is increasing in s, the inflection point splits the bracket
+    const double sc = std::sqrt(-2*x);
+    const double bc = sc > 0 ? normalizedCall(x, sc) : 0;
+    const bool lowerBranch = beta < bc;
+    double lo = lowerBranch ? 0 : sc;
+    double hi = lowerBranch ? sc : INFINITY;
+    double s = lowerBranch ? sc * std::log(bc) / std::log(beta) : std::max(sc, beta * SQRT_2PI); // Linear in 1/ln b below
 
-        sigma -= diff / vega;
-        sigma = std::clamp(sigma, 1e-4, 5.0);
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        const double b = normalizedCall(x, s);
+        if (b > beta) hi = s; else lo = s;
+
+        // Vega b' and the ratios b''/b', b'''/b'
+        const double vega = std::exp(-0.5*(x*x/(s*s) + 0.25*s*s)) / SQRT_2PI;
+        const double h2 = x*x/(s*s*s) - 0.25*s;
+        const double h3 = h2*h2 - 3*x*x/(s*s*s*s) - 0.25;
+
+        double g, g1, g2, g3; // Objective and its derivatives
+        if (lowerBranch) {
+            // 1/ln b is close to linear in s where b itself underflows
+            const double L = std::log(b), v = vega / b;
+            const double L2 = v*h2 - v*v;
+            const double L3 = v*h3 - 3*v*v*h2 + 2*v*v*v;
+            g = 1/L - 1/std::log(beta);
+            g1 = -v/(L*L);
+            g2 = -L2/(L*L) + 2*v*v/(L*L*L);
+            g3 = -L3/(L*L) + 6*v*L2/(L*L*L) - 6*v*v*v/(L*L*L*L);
+        } else {
+            g = b - beta;
+            g1 = vega;
+            g2 = vega*h2;
+            g3 = vega*h3;
+        }
+
+        const double nu = g / g1;
+        const double r2 = g2 / g1;
+        const double r3 = g3 / g1;
+        double step = -nu * (1 + 0.5*r2*nu) / (1 + r2*nu + r3*nu*nu/6);
+        if (!std::isfinite(step))
+            step = -nu;
+
+        if (std::abs(step) <= 1e-6 * s) // Cubic convergence, the next step would be below rounding
+            return s + step;
+
+        s += step;
+        if (!(s > lo && s < hi)) // Left the bracket, bisect instead
+            s = std::isfinite(hi) ? 0.5*(lo + hi) : 2*lo;
     }
 
-    return sigma;
+    return s;
 }
 
-double Functions::computePutIV(double S, double K, double r, double q, double MP, double T) {
-    const int MAX_ITERATIONS = 100;
-    const double TOLERANCE = 1e-8;
+// Prices are reduced to an out-of-the-money forward call, then solved in normalized units
+static double computeIV(bool put, double S, double K, double r, double q, double MP, double T) {
+    const double F = S * std::exp((r-q)*T);
+    const double D = std::exp(-r*T);
+    double price = MP / D; // Undiscounted
 
-    double sigma = 0.2; // Initial Guess
-    double price, vega, diff;
+    // Put-call parity to the out-of-the-money side
+    if (!put && F > K)
+        price -= F - K;
+    if (put && F < K)
+        price -= K - F;
 
-    for (int i = 0; i < MAX_ITERATIONS; i++) {
-        price = computePutPrice(S, K, r, q, sigma, T);
-        vega = computeVega(S, K, r, q, sigma, T);
-        diff = price - MP;
+    const double x = -std::abs(std::log(F/K));
+    return normalizedIV(x, price / std::sqrt(F*K)) / std::sqrt(T);
+}
 
-        if (std::abs(diff) < TOLERANCE)
-            break;
-        if (vega < 1e-12 * std::max(1.0, S))
-            return NAN;
+double Functions::computeCallIV(double S, double K, double r, double q, double MP, double T) {
+    return computeIV(false, S, K, r, q, MP, T);
+}
+
+double Functions::computePutIV(double S, double K, double r, double q, double MP, double T) {
+    return computeIV(true, S, K, r, q, MP, T);
+}
+
+void Functions::computeIVBatch(const IVBatchInput& in, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        out[i] = computeIV(in.put && in.put[i], in.S[i], in.K[i], in.r[i], in.q[i], in.MP[i], in.T[i]);
+}
 
-        sigma -= diff / vega;
-        sigma = std::clamp(sigma, 1e-4, 5.0);
+// Batch kernels
+// Branch-free so that the compiler can vectorize each block loop
+namespace {
+
+constexpr size_t BATCH_BLOCK = 64;
+
+BATCH_TARGETS
+void batchBlock(const Functions::BatchInput& in, const Functions::BatchOutput& out, size_t begin, size_t n) {
+    double sqrtT[BATCH_BLOCK], discQ[BATCH_BLOCK], discR[BATCH_BLOCK];
+    double Nd1[BATCH_BLOCK], Nmd1[BATCH_BLOCK], Nd2[BATCH_BLOCK], Nmd2[BATCH_BLOCK], NPd1[BATCH_BLOCK];
+
+    const double* S = in.S + begin;
+    const double* K = in.K + begin;
+    const double* r = in.r + begin;
+    const double* q = in.q + begin;
+    const double* sigma = in.sigma + begin;
+    const double* T = in.T + begin;
+
+    for (size_t i = 0; i < n; ++i) {
+        sqrtT[i] = std::sqrt(T[i]);
+        const double volT = sigma[i] * sqrtT[i];
+        const double d1 = (FastMath::log(S[i] / K[i]) + (r[i] - q[i] + 0.5 * sigma[i] * sigma[i]) * T[i]) / volT;
+        const double d2 = d1 - volT;
+        discQ[i] = FastMath::exp(-q[i] * T[i]);
+        discR[i] = FastMath::exp(-r[i] * T[i]);
+        NPd1[i] = FastMath::INV_SQRT_2PI * FastMath::exp(-0.5 * d1 * d1);
+        FastMath::normal(d1, Nd1[i], Nmd1[i]);
+        FastMath::normal(d2, Nd2[i], Nmd2[i]);
     }
 
-    return sigma;
+    if (out.callPrice)
+        for (size_t i = 0; i < n; ++i)
+            out.callPrice[begin + i] = S[i] * discQ[i] * Nd1[i] - K[i] * discR[i] * Nd2[i];
+    if (out.putPrice)
+        for (size_t i = 0; i < n; ++i)
+            out.putPrice[begin + i] = K[i] * discR[i] * Nmd2[i] - S[i] * discQ[i] * Nmd1[i];
+    if (out.callDelta)
+        for (size_t i = 0; i < n; ++i)
+            out.callDelta[begin + i] = discQ[i] * Nd1[i];
+    if (out.putDelta)
+        for (size_t i = 0; i < n; ++i)
+            out.putDelta[begin + i] = -discQ[i] * Nmd1[i];
+    if (out.gamma)
+        for (size_t i = 0; i < n; ++i)
+            out.gamma[begin + i] = discQ[i] * NPd1[i] / (S[i] * sigma[i] * sqrtT[i]);
+    if (out.vega)
+        for (size_t i = 0; i < n; ++i)
+            out.vega[begin + i] = S[i] * discQ[i] * NPd1[i] * sqrtT[i];
+    if (out.callTheta)
+        for (size_t i = 0; i < n; ++i)
+            out.callTheta[begin + i] = -(S[i] * NPd1[i] * sigma[i] * discQ[i]) / (2 * sqrtT[i])
+                                       + q[i] * S[i] * discQ[i] * Nd1[i]
+                                       - r[i] * K[i] * discR[i] * Nd2[i];
+    if (out.putTheta)
+        for (size_t i = 0; i < n; ++i)
+            out.putTheta[begin + i] = -(S[i] * NPd1[i] * sigma[i] * discQ[i]) / (2 * sqrtT[i])
+                                      - q[i] * S[i] * discQ[i] * Nmd1[i]
+                                      + r[i] * K[i] * discR[i] * Nmd2[i];
+    if (out.callRho)
+        for (size_t i = 0; i < n; ++i)
+            out.callRho[begin + i] = K[i] * T[i] * discR[i] * Nd2[i];
+    if (out.putRho)
+        for (size_t i = 0; i < n; ++i)
+            out.putRho[begin + i] = -K[i] * T[i] * discR[i] * Nmd2[i];
+}
+
+} // namespace
+
+void Functions::computeBatch(const BatchInput& in, const BatchOutput& out, size_t n) {
+    for (size_t begin = 0; begin < n; begin += BATCH_BLOCK)
+        batchBlock(in, out, begin, std::min(BATCH_BLOCK, n - begin));
+}
+
+double Functions::computeN(double x, Cdf cdf) {
+    double Nx, Nmx;
+    switch (cdf) {
+    case Cdf::EXACT: break;
+    case Cdf::RATIONAL: FastMath::normal(x, Nx, Nmx); return Nx;
+    case Cdf::FAST: FastMath::normalFast(x, Nx, Nmx); return Nx;
+    }
+    return computeN(x);
 }
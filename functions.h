@@ -1,6 +1,8 @@
 #ifndef FUNCTIONSS_H
 #define FUNCTIONSS_H
 
+#include <cstddef>
+
 class Functions
 {
 public:
@@ -12,6 +14,16 @@ public:
     static double computeN(double x);
     static double computeNP(double x);
 
+    // Normal CDF backends, trading accuracy for speed
+    enum class Cdf {
+        EXACT, // std::erfc, full double precision
+        RATIONAL, // Hart/West rational approximation (computeBatch's), |error| < 5e-14
+        FAST, // Abramowitz & Stegun 26.2.17, |error| < 7.5e-8, enough for a color map
+    };
+
+    // The approximations pay off inside vectorized loops (surface rows), a lone scalar call is no faster than EXACT
+    static double computeN(double x, Cdf cdf);
+
     // Price
     static double computeCallPrice(double S, double K, double r, double q, double sigma, double T);
     static double computePutPrice(double S, double K, double r, double q, double sigma, double T);
@@ -26,10 +38,65 @@ public:
     static double computeCallRho(double S, double K, double r, double q, double sigma, double T);
     static double computePutRho(double S, double K, double r, double q, double sigma, double T);
 
-    // Implied Volatility
+    // Price and every Greek from a single d1/d2, N(d1), N(d2) evaluation
+    struct Greeks {
+        double callPrice;
+        double putPrice;
+        double callDelta;
+        double putDelta;
+        double gamma;
+        double vega;
+        double callTheta;
+        double putTheta;
+        double callRho;
+        double putRho;
+    };
+
+    static Greeks computeGreeks(double S, double K, double r, double q, double sigma, double T);
+
+    // Implied Volatility (Householder iteration on normalized Black prices, NAN if MP is out of bounds)
     static double computeCallIV(double S, double K, double r, double q, double MP, double T);
     static double computePutIV(double S, double K, double r, double q, double MP, double T);
 
+    struct IVBatchInput {
+        const double* S;
+        const double* K;
+        const double* r;
+        const double* q;
+        const double* MP; // Market prices
+        const double* T;
+        const bool* put = nullptr; // Per option, null = all calls
+    };
+
+    static void computeIVBatch(const IVBatchInput& in, double* out, size_t n);
+
+    // Batch (Structure-of-Arrays), every input points to n values
+    struct BatchInput {
+        const double* S;
+        const double* K;
+        const double* r;
+        const double* q;
+        const double* sigma;
+        const double* T;
+    };
+
+    // Leave an output null to skip it
+    struct BatchOutput {
+        double* callPrice = nullptr;
+        double* putPrice = nullptr;
+        double* callDelta = nullptr;
+        double* putDelta = nullptr;
+        double* gamma = nullptr;
+        double* vega = nullptr;
+        double* callTheta = nullptr;
+        double* putTheta = nullptr;
+        double* callRho = nullptr;
+        double* putRho = nullptr;
+    };
+
+    // Vectorized log/exp/N(x), dispatched at runtime to AVX-512, AVX2 or scalar code
+    static void computeBatch(const BatchInput& in, const BatchOutput& out, size_t n);
+
 };
 
 #endif // FUNCTIONSS_H
@@ -0,0 +1,558 @@
+#include "grid.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include "kernels.h"
+#include "threadpool.h"
+
+namespace {
+
+constexpr int TERM_COUNT = Kernels::TERM_COUNT;
+
+struct TermInfo {
+    int mask; // Bit i set if the term depends on params[i]
+    double (*f)(const double* p);
+};
+
+// Indexed by Kernels::Term
+const TermInfo termInfo[TERM_COUNT] = {
+    { 1 << 0, [](const double* p) { return p[0]; } },
+    { 1 << 1, [](const double* p) { return p[1]; } },
+    { 1 << 2, [](const double* p) { return p[2]; } },
+    { 1 << 3, [](const double* p) { return p[3]; } },
+    { 1 << 4, [](const double* p) { return p[4]; } },
+    { 1 << 5, [](const double* p) { return p[5]; } },
+    { 1 << 0, [](const double* p) { return std::log(p[0]); } },
+    { 1 << 1, [](const double* p) { return std::log(p[1]); } },
+    { 1 << 5, [](const double* p) { return std::sqrt(p[5]); } },
+    { 1 << 3 | 1 << 5, [](const double* p) { return std::exp(-p[3] * p[5]); } },
+    { 1 << 2 | 1 << 5, [](const double* p) { return std::exp(-p[2] * p[5]); } },
+};
+
+using AxisTerm = Grid::AxisTerm;
+
+// Samples every term along the axis it depends on, skipping terms already sampled from the same inputs.
+// False if a term depends on both axes.
+bool buildTerms(const Grid::Request& request, AxisTerm* terms, Grid::TermCache* cache) {
+    const int n = request.samples;
+    const double delta_x = (request.max_x - request.min_x) / (n - 1);
+    const double delta_y = (request.max_y - request.min_y) / (n - 1);
+
+    double params[6];
+    std::copy(std::begin(request.params), std::end(request.params), params);
+
+    for (int t = 0; t < TERM_COUNT; ++t) {
+        const bool onX = termInfo[t].mask & (1 << request.idx);
+        const bool onY = termInfo[t].mask & (1 << request.idy);
+        if (onX && onY)
+            return false;
+
+        // Dependencies of this term in the current request
+        double inputs[6] = {};
+        for (int i = 0; i < 6; ++i)
+            if (termInfo[t].mask & (1 << i) && i != request.idx && i != request.idy)
+                inputs[i] = request.params[i];
+        const double from = onX ? request.min_x : onY ? request.min_y : 0;
+        const double to = onX ? request.max_x : onY ? request.max_y : 0;
+        const size_t size = onX || onY ? n : 1;
+
+        AxisTerm& term = terms[t];
+        if (cache && term.values.size() == size && term.strideX == int(onX) && term.strideY == int(onY)
+            && term.from == from && term.to == to && std::equal(std::begin(inputs), std::end(inputs), term.inputs)) {
+            ++cache->reused;
+            continue;
+        }
+
+        term.strideX = onX ? 1 : 0;
+        term.strideY = onY ? 1 : 0;
+        term.values.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            if (onX) params[request.idx] = request.min_x + i * delta_x;
+            if (onY) params[request.idy] = request.min_y + i * delta_y;
+            term.values[i] = termInfo[t].f(params);
+        }
+        std::copy(std::begin(request.params), std::end(request.params), params);
+
+        std::copy(std::begin(inputs), std::end(inputs), term.inputs);
+        term.from = from;
+        term.to = to;
+        if (cache)
+            ++cache->resampled;
+    }
+    return true;
+}
+
+// Evaluates single cells, used where the grid is not swept in order (adaptive refinement)
+struct Sampler {
+    const Grid::Request& request;
+    const Kernels::TermView* terms;
+    const Kernels::Kernel* kernel; // nullptr falls back to computeZ
+    double delta_x;
+    double delta_y;
+
+    double operator()(int x, int y) const {
+        if (kernel) {
+            double v[TERM_COUNT];
+            for (int t = 0; t < TERM_COUNT; ++t)
+                v[t] = terms[t].values[x * terms[t].strideX + y * terms[t].strideY];
+            return kernel->cell(v);
+        }
+
+        double params[6];
+        std::copy(std::begin(request.params), std::end(request.params), params);
+        params[request.idx] = request.min_x + x * delta_x;
+        params[request.idy] = request.min_y + y * delta_y;
+        return request.computeZ(request.mode, params[0], params[1], params[2], params[3], params[4], params[5]);
+    }
+};
+
+// Lattice of a stride: every stride-th index plus the last one, nested in the lattice of stride / 2
+bool inLattice(int i, int stride, int n) {
+    return stride > 0 && (i % stride == 0 || i == n - 1);
+}
+
+// Surfaces with a whole surface evaluator get every lattice cell in one call, written straight into result.z.
+// False if superseded.
+bool evaluateSurface(const Grid::Request& request, Grid::Result& result, int stride, const std::atomic<unsigned long long>& latest) {
+    const int n = request.samples;
+    const double delta_x = (request.max_x - request.min_x) / (n - 1);
+    const double delta_y = (request.max_y - request.min_y) / (n - 1);
+
+    // Same lattice indices along both axes
+    std::vector<int> lattice;
+    std::vector<double> xs, ys;
+    for (int i = 0; i < n; ++i) {
+        if (!inLattice(i, stride, n))
+            continue;
+        lattice.push_back(i);
+        xs.push_back(request.min_x + i * delta_x);
+        ys.push_back(request.min_y + i * delta_y);
+    }
+
+    const int count = static_cast<int>(lattice.size());
+    std::vector<double> z(static_cast<size_t>(count) * count);
+    request.computeSurface(request.mode, xs.data(), count, ys.data(), count, request.params, z.data());
+    for (int c = 0; c < count; ++c) {
+        for (int i = 0; i < count; ++i)
+            result.z[static_cast<size_t>(lattice[i]) * n + lattice[c]] = z[static_cast<size_t>(c) * count + i];
+    }
+    return latest.load(std::memory_order_relaxed) == request.generation;
+}
+
+// Share of Grid::Range from one tile or block, written to its own slot and merged after the parallel loop
+struct RangePart {
+    double min = INFINITY;
+    double max = -INFINITY;
+    int nanCount = 0;
+    int picked = 0; // Quantile samples stored in the part's picks
+
+    void add(double z) {
+        if (std::isnan(z)) {
+            ++nanCount;
+        } else {
+            min = std::min(min, z);
+            max = std::max(max, z);
+        }
+    }
+};
+
+class RangeBuilder
+{
+public:
+    RangeBuilder(int count, int picksPerPart) : parts(count), picksPerPart(picksPerPart), picks(static_cast<size_t>(count) * picksPerPart) {}
+
+    double* picksOf(int part) { return picks.data() + static_cast<size_t>(part) * picksPerPart; }
+    void set(int part, const RangePart& range) { parts[part] = range; }
+
+    // extraNaN counts NaN cells outside the parts (interpolated gaps)
+    Grid::Range finish(int extraNaN) {
+        Grid::Range range = { INFINITY, -INFINITY, extraNaN, NAN, NAN };
+        size_t sampled = 0;
+        for (size_t part = 0; part < parts.size(); ++part) {
+            range.min = std::min(range.min, parts[part].min);
+            range.max = std::max(range.max, parts[part].max);
+            range.nanCount += parts[part].nanCount;
+            const double* from = picks.data() + part * picksPerPart; // Compacted in place, NaN already left out
+            std::copy(from, from + parts[part].picked, picks.begin() + sampled);
+            sampled += parts[part].picked;
+        }
+        if (range.min > range.max) {
+            range.min = range.max = NAN;
+            return range;
+        }
+        if (sampled == 0) { // Every sampled cell was NaN
+            range.low = range.min;
+            range.high = range.max;
+            return range;
+        }
+
+        const size_t lowIndex = static_cast<size_t>(Grid::ROBUST_QUANTILE * (sampled - 1));
+        const size_t highIndex = sampled - 1 - lowIndex;
+        std::nth_element(picks.begin(), picks.begin() + lowIndex, picks.begin() + sampled);
+        range.low = picks[lowIndex];
+        std::nth_element(picks.begin() + lowIndex, picks.begin() + highIndex, picks.begin() + sampled);
+        range.high = picks[highIndex];
+        return range;
+    }
+
+private:
+    std::vector<RangePart> parts;
+    int picksPerPart;
+    std::vector<double> picks;
+};
+
+// Quadtree refinement of one block held in a local (w+1) x (h+1) buffer
+class BlockRefiner
+{
+public:
+    BlockRefiner(const Sampler& sample, int x0, int y0, int x1, int y1, double tolerance) :
+        sample(sample), x0(x0), y0(y0), w(x1 - x0 + 1), tolerance(tolerance),
+        values(static_cast<size_t>(w) * (y1 - y0 + 1)), known(values.size(), false), evaluated(0)
+    {
+        at(x0, y0); at(x1, y0); at(x0, y1); at(x1, y1);
+        refine(x0, y0, x1, y1);
+    }
+
+    double value(int x, int y) const { return values[index(x, y)]; }
+    int evaluatedCount() const { return evaluated; }
+
+private:
+    size_t index(int x, int y) const { return static_cast<size_t>(y - y0) * w + (x - x0); }
+
+    double at(int x, int y) {
+        const size_t i = index(x, y);
+        if (!known[i]) {
+            values[i] = sample(x, y);
+            known[i] = true;
+            ++evaluated;
+        }
+        return values[i];
+    }
+
+    // Corners of (ax, ay, bx, by) are known on entry
+    void refine(int ax, int ay, int bx, int by) {
+        if (bx - ax <= 1 && by - ay <= 1)
+            return;
+
+        const int mx = (ax + bx) / 2;
+        const int my = (ay + by) / 2;
+        const double z00 = at(ax, ay), z10 = at(bx, ay), z01 = at(ax, by), z11 = at(bx, by);
+
+        // Compare edge midpoints and the centre against bilinear interpolation of the corners
+        const double tx = bx > ax ? double(mx - ax) / (bx - ax) : 0.0;
+        const double ty = by > ay ? double(my - ay) / (by - ay) : 0.0;
+        const double err = std::max({
+            std::abs(at(mx, ay) - (z00 + tx * (z10 - z00))),
+            std::abs(at(mx, by) - (z01 + tx * (z11 - z01))),
+            std::abs(at(ax, my) - (z00 + ty * (z01 - z00))),
+            std::abs(at(bx, my) - (z10 + ty * (z11 - z10))),
+            std::abs(at(mx, my) - bilinear(ax, ay, bx, by, mx, my)),
+        });
+
+        if (err <= tolerance) { // NaN fails this test and keeps refining
+            for (int y = ay; y <= by; ++y)
+                for (int x = ax; x <= bx; ++x)
+                    if (!known[index(x, y)])
+                        values[index(x, y)] = bilinear(ax, ay, bx, by, x, y);
+            return;
+        }
+
+        refine(ax, ay, mx, my);
+        refine(mx, ay, bx, my);
+        refine(ax, my, mx, by);
+        refine(mx, my, bx, by);
+    }
+
+    double bilinear(int ax, int ay, int bx, int by, int x, int y) const {
+        const double tx = bx > ax ? double(x - ax) / (bx - ax) : 0.0;
+        const double ty = by > ay ? double(y - ay) / (by - ay) : 0.0;
+        const double bottom = value(ax, ay) + tx * (value(bx, ay) - value(ax, ay));
+        const double top = value(ax, by) + tx * (value(bx, by) - value(ax, by));
+        return bottom + ty * (top - bottom);
+    }
+
+    const Sampler& sample;
+    int x0;
+    int y0;
+    int w;
+    double tolerance;
+    std::vector<double> values;
+    std::vector<bool> known;
+    int evaluated;
+};
+
+// Refines ADAPTIVE_BLOCK sized blocks in parallel, each into its own buffer
+bool evaluateAdaptive(const Grid::Request& request, Grid::Result& result, const std::atomic<unsigned long long>& latest, const Sampler& sample) {
+    const int n = request.samples;
+    const int blocksPerSide = (n - 2) / Grid::ADAPTIVE_BLOCK + 1; // Blocks share their edge cells
+
+    // Tolerance relative to the value range seen on the block corners
+    double lo = INFINITY, hi = -INFINITY;
+    for (int by = 0; by <= blocksPerSide; ++by) {
+        for (int bx = 0; bx <= blocksPerSide; ++bx) {
+            const double z = sample(std::min(bx * Grid::ADAPTIVE_BLOCK, n - 1), std::min(by * Grid::ADAPTIVE_BLOCK, n - 1));
+            if (std::isfinite(z)) {
+                lo = std::min(lo, z);
+                hi = std::max(hi, z);
+            }
+        }
+    }
+    const double tolerance = hi > lo ? Grid::ADAPTIVE_TOLERANCE * (hi - lo) : 0.0;
+
+    std::atomic<bool> cancelled(false);
+    std::atomic<int> evaluated(0);
+    constexpr int picksPerSide = Grid::ADAPTIVE_BLOCK / Grid::RANGE_PICK_STEP + 1;
+    constexpr int pickOffset = Grid::RANGE_PICK_STEP / 2; // Centre of each step x step square, edges would count double
+    RangeBuilder ranges(blocksPerSide * blocksPerSide, picksPerSide * picksPerSide);
+
+    ThreadPool::instance().parallelFor(blocksPerSide * blocksPerSide, [&](int block) {
+        if (cancelled.load(std::memory_order_relaxed) || latest.load(std::memory_order_relaxed) != request.generation) {
+            cancelled.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        const int x0 = (block % blocksPerSide) * Grid::ADAPTIVE_BLOCK;
+        const int y0 = (block / blocksPerSide) * Grid::ADAPTIVE_BLOCK;
+        const int x1 = std::min(x0 + Grid::ADAPTIVE_BLOCK, n - 1);
+        const int y1 = std::min(y0 + Grid::ADAPTIVE_BLOCK, n - 1);
+
+        BlockRefiner refiner(sample, x0, y0, x1, y1, tolerance);
+        evaluated += refiner.evaluatedCount();
+
+        // Each block writes its lower/left edges, the last row/column also write the far edge
+        const int xEnd = x1 == n - 1 ? x1 : x1 - 1;
+        const int yEnd = y1 == n - 1 ? y1 : y1 - 1;
+        RangePart range;
+        double* picks = ranges.picksOf(block);
+        for (int y = y0; y <= yEnd; ++y) {
+            for (int x = x0; x <= xEnd; ++x) {
+                const double z = refiner.value(x, y);
+                result.z[static_cast<size_t>(y) * n + x] = z;
+                range.add(z);
+                if (x % Grid::RANGE_PICK_STEP == pickOffset && y % Grid::RANGE_PICK_STEP == pickOffset && !std::isnan(z))
+                    picks[range.picked++] = z;
+            }
+        }
+        ranges.set(block, range);
+    });
+
+    result.evaluated = evaluated;
+    if (cancelled || latest.load(std::memory_order_relaxed) != request.generation)
+        return false;
+    result.range = ranges.finish(0);
+    return true;
+}
+
+// Pre-samples the terms (into cache if given) and picks the specialized kernel once per surface
+struct Terms {
+    AxisTerm local[TERM_COUNT];
+    AxisTerm* axis;
+    Kernels::TermView views[TERM_COUNT];
+    const Kernels::Kernel* kernel;
+    const Kernels::Kernel* reference; // Double FAST kernel a float kernel is checked against, else nullptr
+
+    Terms(const Grid::Request& request, Grid::TermCache* cache) : axis(cache ? cache->terms : local), kernel(nullptr), reference(nullptr) {
+        if (!buildTerms(request, axis, cache))
+            return; // A term spans both axes, only computeZ can evaluate it
+        for (int t = 0; t < TERM_COUNT; ++t)
+            views[t] = { axis[t].values.data(), axis[t].strideX, axis[t].strideY };
+        const bool single = request.single && !request.adaptive;
+        kernel = Kernels::lookup(request.surfaceMode, request.mode, request.cdf, single);
+        if (single)
+            reference = Kernels::lookup(request.surfaceMode, request.mode, Functions::Cdf::FAST);
+    }
+};
+
+// Compares a FLOAT_CHECK x FLOAT_CHECK lattice of the float grid against the double kernel,
+// false if any cell is off by more than FLOAT_TOLERANCE of the z range or disagrees on NaN
+bool withinFloatTolerance(const Grid::Result& result, const Terms& terms) {
+    const int n = result.request.samples;
+    const int count = std::min(Grid::FLOAT_CHECK, n);
+    std::vector<double> expected(static_cast<size_t>(count) * count);
+    std::vector<double> actual(expected.size());
+
+    double lo = INFINITY, hi = -INFINITY;
+    for (int j = 0; j < count; ++j) {
+        const int y = count > 1 ? j * (n - 1) / (count - 1) : 0;
+        for (int i = 0; i < count; ++i) {
+            const int x = count > 1 ? i * (n - 1) / (count - 1) : 0;
+            double v[TERM_COUNT];
+            for (int t = 0; t < TERM_COUNT; ++t)
+                v[t] = terms.views[t].values[x * terms.views[t].strideX + y * terms.views[t].strideY];
+            const double z = terms.reference->cell(v);
+            expected[static_cast<size_t>(j) * count + i] = z;
+            actual[static_cast<size_t>(j) * count + i] = result.z[static_cast<size_t>(y) * n + x];
+            if (std::isfinite(z)) {
+                lo = std::min(lo, z);
+                hi = std::max(hi, z);
+            }
+        }
+    }
+
+    // A flat surface is measured against its magnitude instead
+    const double scale = hi > lo ? hi - lo : (std::isfinite(hi) ? std::fabs(hi) : 0.0);
+    const double tolerance = Grid::FLOAT_TOLERANCE * scale;
+    for (size_t c = 0; c < expected.size(); ++c) {
+        if (std::isnan(expected[c]) != std::isnan(actual[c]))
+            return false;
+        if (!std::isnan(expected[c]) && !(std::fabs(actual[c] - expected[c]) <= tolerance))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Grid::Grid() {}
+
+bool Grid::evaluate(const Request& request, Result& result, const std::atomic<unsigned long long>& latest, TermCache* cache) {
+    // A whole surface solve costs less than refining cell by cell
+    if (!request.adaptive || request.computeSurface)
+        return evaluatePass(request, result, 1, 0, latest, cache);
+
+    const int n = request.samples;
+    result.request = request;
+    result.z.resize(static_cast<size_t>(n) * n);
+    result.evaluated = 0;
+    result.range = { NAN, NAN, 0, NAN, NAN };
+
+    const Terms terms(request, cache);
+    const Sampler sample{ request, terms.views, terms.kernel, (request.max_x - request.min_x) / (n - 1), (request.max_y - request.min_y) / (n - 1) };
+    return evaluateAdaptive(request, result, latest, sample);
+}
+
+int Grid::coarsestStride(int samples) {
+    int stride = 1;
+    while ((samples - 1) / (stride * 2) >= PROGRESSIVE_START - 1)
+        stride *= 2;
+    return stride;
+}
+
+bool Grid::evaluatePass(const Request& request, Result& result, int stride, int knownStride, const std::atomic<unsigned long long>& latest, TermCache* cache) {
+    const int n = request.samples;
+
+    if (knownStride == 0) {
+        result.request = request;
+        result.z.resize(static_cast<size_t>(n) * n);
+        result.evaluated = 0;
+        result.range = { NAN, NAN, 0, NAN, NAN };
+    }
+
+    // Registered modes run their specialized row kernel over per-axis terms, anything else goes through computeZ
+    const Terms terms(request, cache);
+    const Sampler sample{ request, terms.views, terms.kernel, (request.max_x - request.min_x) / (n - 1), (request.max_y - request.min_y) / (n - 1) };
+
+    auto onLattice = [n](int i, int s) { return inLattice(i, s, n); };
+
+    // Whole surface solves fill the lattice in one call, the tiles below only gather the range
+    const bool solved = !terms.kernel && request.computeSurface;
+    if (solved && !evaluateSurface(request, result, stride, latest))
+        return false;
+
+    const int tilesPerSide = (n + TILE - 1) / TILE;
+    std::atomic<bool> cancelled(false);
+    std::atomic<int> evaluated(0);
+
+    // Range of the lattice, bilinear gaps stay within it. Quantiles sample a sub-lattice of it, at the centre
+    // of each pickStep square when that is on the lattice, edges would count double.
+    const int pickStep = std::max(RANGE_PICK_STEP, stride);
+    const int pickOffset = pickStep > stride ? pickStep / 2 : 0;
+    RangeBuilder ranges(tilesPerSide * tilesPerSide, (TILE / RANGE_PICK_STEP) * (TILE / RANGE_PICK_STEP));
+
+    ThreadPool::instance().parallelFor(tilesPerSide * tilesPerSide, [&](int tile) {
+        // Stop early once a newer request has been issued
+        if (cancelled.load(std::memory_order_relaxed) || latest.load(std::memory_order_relaxed) != request.generation) {
+            cancelled.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        const int x0 = (tile % tilesPerSide) * TILE;
+        const int y0 = (tile / tilesPerSide) * TILE;
+        const int x1 = std::min(x0 + TILE, n);
+        const int y1 = std::min(y0 + TILE, n);
+
+        int count = 0;
+        RangePart range;
+        double* picks = ranges.picksOf(tile);
+        for (int y = y0; y < y1; ++y) {
+            if (!onLattice(y, stride))
+                continue;
+            const bool knownRow = onLattice(y, knownStride);
+            double* row = result.z.data() + static_cast<size_t>(y) * n;
+
+            // Rows already on the previous lattice only need its odd multiples of stride
+            const int step = knownRow ? 2 * stride : stride;
+            const int first = knownRow ? stride : 0;
+            const int xBegin = x0 + (first - x0 % step + step) % step;
+            const int xEnd = knownRow ? std::min(x1, n - 1) : x1; // The last column is on every lattice
+            const bool lastColumn = !knownRow && x1 == n && (n - 1) % stride != 0; // Off the step, but always on the lattice
+
+            if (terms.kernel) {
+                terms.kernel->row({ terms.views, y, xBegin, xEnd, step, row });
+                if (lastColumn)
+                    terms.kernel->row({ terms.views, y, n - 1, n, 1, row });
+            } else if (!solved) {
+                for (int x = xBegin; x < xEnd; x += step)
+                    row[x] = sample(x, y);
+                if (lastColumn)
+                    row[n - 1] = sample(n - 1, y);
+            }
+            count += (xEnd > xBegin ? (xEnd - 1 - xBegin) / step + 1 : 0) + (lastColumn ? 1 : 0);
+
+            // Still in cache, includes the cells known from the previous pass
+            for (int x = x0; x < x1; ++x) {
+                if (stride > 1 && !onLattice(x, stride))
+                    continue;
+                range.add(row[x]);
+                if (x % pickStep == pickOffset && y % pickStep == pickOffset && !std::isnan(row[x]))
+                    picks[range.picked++] = row[x];
+            }
+        }
+        ranges.set(tile, range);
+        evaluated += count;
+    });
+
+    result.evaluated += evaluated;
+    if (cancelled || latest.load(std::memory_order_relaxed) != request.generation)
+        return false;
+
+    // Fill cells between lattice points bilinearly, a gap next to a NaN corner is NaN too
+    std::vector<int> gapNaN(stride > 1 ? n : 0, 0);
+    if (stride > 1) {
+        ThreadPool::instance().parallelFor(n, [&](int y) {
+            const int ya = onLattice(y, stride) ? y : (y / stride) * stride;
+            const int yb = onLattice(y, stride) ? y : std::min(ya + stride, n - 1);
+            const double ty = yb > ya ? double(y - ya) / (yb - ya) : 0.0;
+            const double* za = result.z.data() + static_cast<size_t>(ya) * n;
+            const double* zb = result.z.data() + static_cast<size_t>(yb) * n;
+            double* row = result.z.data() + static_cast<size_t>(y) * n;
+
+            for (int x = 0; x < n; ++x) {
+                if (onLattice(x, stride) && onLattice(y, stride))
+                    continue;
+                const int xa = onLattice(x, stride) ? x : (x / stride) * stride;
+                const int xb = onLattice(x, stride) ? x : std::min(xa + stride, n - 1);
+                const double tx = xb > xa ? double(x - xa) / (xb - xa) : 0.0;
+                const double bottom = za[xa] + tx * (za[xb] - za[xa]);
+                const double top = zb[xa] + tx * (zb[xb] - zb[xa]);
+                row[x] = bottom + ty * (top - bottom);
+                gapNaN[y] += std::isnan(row[x]);
+            }
+        });
+    }
+
+    if (stride == 1 && terms.reference && !withinFloatTolerance(result, terms)) {
+        Request exact = request;
+        exact.single = false;
+        if (!evaluatePass(exact, result, 1, 0, latest, cache))
+            return false;
+        result.request = request;
+        return true;
+    }
+
+    int nanGaps = 0;
+    for (int count : gapNaN)
+        nanGaps += count;
+    result.range = ranges.finish(nanGaps);
+    return true;
+}
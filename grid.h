@@ -0,0 +1,96 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "kernels.h"
+#include "surface.h"
+
+class Grid
+{
+public:
+    Grid();
+
+    // Snapshot of every input needed to evaluate one surface
+    struct Request {
+        unsigned long long generation; // Id used to detect superseded requests
+
+        Surface::SurfaceMode surfaceMode; // Selects the specialized kernel
+        Surface::OptionMode mode;
+        std::function<double(Surface::OptionMode mode, double S, double K, double r, double q, double sigma, double T)> computeZ; // Fallback for surfaces without a kernel
+        std::function<void(Surface::OptionMode mode, const double* x, int countX, const double* y, int countY, const double* params, double* z)> computeSurface; // SurfaceConfig::computeSurface, replaces computeZ, adaptive included
+
+        double params[6]; // S, K, r, q, sigma, T
+        int idx; // Index in params swept along x
+        int idy; // Index in params swept along y
+        double min_x;
+        double max_x;
+        double min_y;
+        double max_y;
+
+        Functions::Cdf cdf; // Normal CDF backend of the kernel, computeZ is always exact
+        int samples; // Grid is samples x samples
+        bool adaptive; // Quadtree refinement instead of evaluating every cell. Ignored with computeSurface.
+        bool single; // float kernel with the FAST CDF, checked against double and redone in double if off. Ignored when adaptive.
+    };
+
+    // Value statistics gathered while the grid is evaluated, no extra pass over z
+    struct Range {
+        double min; // Non-NaN cells, NaN if every cell is NaN
+        double max;
+        int nanCount;
+        double low; // ROBUST_QUANTILE quantile, estimated from every RANGE_PICK_STEP-th cell per axis
+        double high; // 1 - ROBUST_QUANTILE quantile
+    };
+
+    struct Result {
+        Request request;
+        std::vector<double> z; // Row-major, z[y * samples + x]
+        int evaluated; // Cells actually computed, the rest are interpolated
+        Range range;
+    };
+
+    // A term sampled once per column (x), once per row (y) or once per grid; value at (x, y) is values[x * strideX + y * strideY]
+    struct AxisTerm {
+        std::vector<double> values;
+        int strideX = 0;
+        int strideY = 0;
+
+        // Inputs the values were sampled from
+        double inputs[6] = {}; // Fixed params the term depends on, others 0
+        double from = 0; // Swept range, 0 if the term is constant
+        double to = 0;
+    };
+
+    // Terms of the previous request. Passed to consecutive evaluations it resamples only the terms whose
+    // fixed params or swept axis changed, e.g. moving r keeps every S, K, sigma and sqrt(T) sample.
+    // One evaluation at a time.
+    struct TermCache {
+        AxisTerm terms[Kernels::TERM_COUNT];
+        unsigned long long resampled = 0; // Terms rebuilt since construction
+        unsigned long long reused = 0;
+    };
+
+    static constexpr int TILE = 64; // Tile edge in cells, 64x64 doubles = 32KB
+    static constexpr int ADAPTIVE_BLOCK = 16; // Coarsest quadtree cell, features narrower than this can be missed
+    static constexpr double ADAPTIVE_TOLERANCE = 1e-3; // Max interpolation error as a fraction of the z range
+    static constexpr int PROGRESSIVE_START = 25; // Minimum samples per axis of the first progressive pass
+    static constexpr int FLOAT_CHECK = 16; // Cells per axis compared against double after a single precision pass
+    static constexpr double FLOAT_TOLERANCE = 1e-4; // Max float error as a fraction of the z range
+    static constexpr int RANGE_PICK_STEP = 4; // Cells per axis between quantile samples (power of two)
+    static constexpr double ROBUST_QUANTILE = 0.01; // Tail left out of Range::low / Range::high
+
+    // Fills result from request, tiles are evaluated in parallel on ThreadPool::instance().
+    // Returns false if latest moved past request.generation before finishing.
+    // cache (optional) carries sampled terms over from the previous request.
+    static bool evaluate(const Request& request, Result& result, const std::atomic<unsigned long long>& latest, TermCache* cache = nullptr);
+
+    // Progressive passes: evaluates every stride-th cell (plus the last row/column) except those already
+    // computed by the knownStride pass (0 = none), then fills the gaps bilinearly. Strides halve down to 1.
+    // A single precision request is checked on the stride 1 pass and redone in double if the check fails.
+    static bool evaluatePass(const Request& request, Result& result, int stride, int knownStride, const std::atomic<unsigned long long>& latest, TermCache* cache = nullptr);
+    static int coarsestStride(int samples); // Stride of the first pass, at least PROGRESSIVE_START samples per axis
+};
+
+#endif // GRID_H
@@ -0,0 +1,157 @@
+#include "heston.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "fastmath.h"
+
+Heston::Heston() {}
+
+namespace {
+
+using Complex = std::complex<double>;
+using Model = Heston::Model;
+
+constexpr double PI = 3.141592653589793;
+
+// Characteristic function of log(S_T / S), in the form of Albrecher et al. (2007) that stays on the principal
+// branch of the logarithm at long expiries
+Complex characteristic(double u, double r, double q, double T, const Model& m) {
+    const Complex iu(0.0, u);
+    const double xi2 = m.xi * m.xi;
+    const Complex beta = m.kappa - m.rho * m.xi * iu;
+    const Complex d = std::sqrt(beta * beta + xi2 * (iu + u * u));
+    const Complex g = (beta - d) / (beta + d);
+    const Complex decay = std::exp(-d * T);
+    const Complex C = (r - q) * T * iu + m.kappa * m.theta / xi2 * ((beta - d) * T - 2.0 * std::log((1.0 - g * decay) / (1.0 - g)));
+    const Complex D = (beta - d) / xi2 * (1.0 - decay) / (1.0 - g * decay);
+    return std::exp(C + D * m.v0);
+}
+
+// Cosine coefficients of the density of log(S_T / S) on [a, b], the interval centred on its first cumulant and
+// TRUNCATION times the square root of its second wide, both in closed form (Fang & Oosterlee, 2008, appendix).
+// The part of the price that does not depend on the strike, kept per thread for the next strip.
+struct Expansion {
+    double r = NAN, q = NAN, T = NAN;
+    Model model = { NAN, NAN, NAN, NAN, NAN };
+    int terms = 0;
+
+    double a = 0, b = 0;
+    double expA = 0; // e^a
+    double omega = 0; // pi / (b - a), the frequency of term k is k omega
+    std::vector<double> put; // Term k of a put per unit of K, A_k / (k omega), 0 for k = 0
+    std::vector<double> spot; // Term k per unit of S, A_k / (1 + (k omega)^2)
+    std::vector<double> spotSine; // A_k k omega / (1 + (k omega)^2)
+    double weight0 = 0; // A_0 / 2
+
+    bool matches(double r_, double q_, double T_, const Model& m, int terms_) const {
+        return r == r_ && q == q_ && T == T_ && terms == terms_ && model.v0 == m.v0 && model.kappa == m.kappa
+               && model.theta == m.theta && model.xi == m.xi && model.rho == m.rho;
+    }
+
+    void build(double r_, double q_, double T_, const Model& m, int terms_) {
+        r = r_, q = q_, T = T_, model = m, terms = terms_;
+
+        const double k = m.kappa, eta = m.xi, rho = m.rho, v0 = m.v0, th = m.theta;
+        const double e1 = std::exp(-k * T), e2 = std::exp(-2.0 * k * T);
+        const double c1 = (r - q) * T + (1.0 - e1) * (th - v0) / (2.0 * k) - 0.5 * th * T;
+        const double c2 = (eta * T * k * e1 * (v0 - th) * (8.0 * k * rho - 4.0 * eta)
+                           + k * rho * eta * (1.0 - e1) * (16.0 * th - 8.0 * v0)
+                           + 2.0 * th * k * T * (-4.0 * k * rho * eta + eta * eta + 4.0 * k * k)
+                           + eta * eta * ((th - 2.0 * v0) * e2 + th * (6.0 * e1 - 7.0) + 2.0 * v0)
+                           + 8.0 * k * k * (v0 - th) * (1.0 - e1))
+                          / (8.0 * k * k * k);
+        const double width = Heston::TRUNCATION * std::sqrt(std::max(std::fabs(c2), 1e-12));
+        a = c1 - width;
+        b = c1 + width;
+        expA = std::exp(a);
+        omega = PI / (b - a);
+
+        put.assign(terms, 0.0);
+        spot.assign(terms, 0.0);
+        spotSine.assign(terms, 0.0);
+        for (int n = 0; n < terms; ++n) {
+            const double u = n * omega;
+            const double A = 2.0 / (b - a) * std::real(characteristic(u, r, q, T, m) * std::exp(Complex(0.0, -u * a)));
+            if (n == 0) {
+                weight0 = 0.5 * A;
+                continue;
+            }
+            put[n] = A / u;
+            spot[n] = A / (1.0 + u * u);
+            spotSine[n] = A * u / (1.0 + u * u);
+        }
+    }
+};
+
+// Undiscounted put prices: the integral of (K - S e^y) cos(k omega (y - a)) over [a, d], d = log(K / S) within
+// [a, b], against each coefficient. cos and sin of k omega (d - a) advance by one rotation per term, the inner
+// loop runs over strikes and vectorizes.
+BATCH_TARGETS
+void putBlock(const Expansion& e, double S, const double* K, int count, double* out) {
+    double cosine[Heston::STRIP_BLOCK], sine[Heston::STRIP_BLOCK], stepCos[Heston::STRIP_BLOCK], stepSin[Heston::STRIP_BLOCK];
+    double expD[Heston::STRIP_BLOCK];
+    for (int j = 0; j < count; ++j) {
+        const double d = std::min(std::max(std::log(K[j] / S), e.a), e.b);
+        const double delta = d - e.a;
+        expD[j] = std::exp(d);
+        stepCos[j] = std::cos(e.omega * delta);
+        stepSin[j] = std::sin(e.omega * delta);
+        cosine[j] = 1.0;
+        sine[j] = 0.0;
+        out[j] = e.weight0 * (K[j] * delta - S * (expD[j] - e.expA));
+    }
+
+    for (int n = 1; n < e.terms; ++n) {
+        const double put = e.put[n], spot = e.spot[n], spotSine = e.spotSine[n];
+        for (int j = 0; j < count; ++j) {
+            const double c = cosine[j] * stepCos[j] - sine[j] * stepSin[j];
+            const double s = sine[j] * stepCos[j] + cosine[j] * stepSin[j];
+            cosine[j] = c;
+            sine[j] = s;
+            out[j] += K[j] * put * s - S * (spot * (c * expD[j] - e.expA) + spotSine * s * expD[j]);
+        }
+    }
+}
+
+bool validModel(const Model& m) {
+    return m.v0 >= 0 && m.kappa > 0 && m.theta >= 0 && m.xi > 0 && m.rho >= -1 && m.rho <= 1
+           && std::isfinite(m.v0 + m.kappa + m.theta + m.xi);
+}
+
+} // namespace
+
+void Heston::strip(bool put, double S, const double* K, int count, double r, double q, double T, const Model& model, double* out, int terms) {
+    std::fill(out, out + count, NAN);
+    if (!(S > 0) || !std::isfinite(S) || !(T > 0) || !std::isfinite(T) || !std::isfinite(r) || !std::isfinite(q) || !validModel(model) || terms < 8)
+        return;
+
+    thread_local Expansion expansion;
+    if (!expansion.matches(r, q, T, model, terms))
+        expansion.build(r, q, T, model, terms);
+
+    // Puts from the expansion, calls by parity, which is better conditioned than expanding the call payoff
+    const double discR = std::exp(-r * T), discQ = std::exp(-q * T);
+    double strikes[STRIP_BLOCK], block[STRIP_BLOCK];
+    int index[STRIP_BLOCK];
+    for (int begin = 0; begin < count;) {
+        int n = 0;
+        for (; begin < count && n < STRIP_BLOCK; ++begin) {
+            if (K[begin] > 0 && std::isfinite(K[begin])) {
+                strikes[n] = K[begin];
+                index[n++] = begin;
+            }
+        }
+        putBlock(expansion, S, strikes, n, block);
+        for (int j = 0; j < n; ++j) {
+            const double putPrice = std::max(discR * block[j], 0.0);
+            out[index[j]] = put ? putPrice : std::max(putPrice + S * discQ - strikes[j] * discR, 0.0);
+        }
+    }
+}
+
+double Heston::price(bool put, double S, double K, double r, double q, double T, const Model& model, int terms) {
+    double out;
+    strip(put, S, &K, 1, r, q, T, model, &out, terms);
+    return out;
+}
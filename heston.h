@@ -0,0 +1,34 @@
+#ifndef HESTON_H
+#define HESTON_H
+
+// European options under the Heston stochastic volatility model, priced by the COS method (Fang & Oosterlee,
+// 2008): a cosine expansion of the density of log S_T whose coefficients come from the characteristic
+// function. The coefficients depend on the expiry and the model only, so a strike strip shares them.
+class Heston
+{
+public:
+    Heston();
+
+    // dS = (r - q) S dt + sqrt(v) S dW1, dv = kappa (theta - v) dt + xi sqrt(v) dW2, dW1 dW2 = rho dt
+    struct Model {
+        double v0; // Variance at t = 0
+        double kappa; // Speed of mean reversion of the variance
+        double theta; // Long-run variance
+        double xi; // Volatility of the variance
+        double rho; // Correlation of the spot and variance shocks
+    };
+
+    static constexpr int COS_TERMS = 256; // Default terms of the expansion
+    static constexpr double TRUNCATION = 16.0; // Standard deviations of log S_T kept either side of its mean, the tails are fat
+    static constexpr int STRIP_BLOCK = 256; // Strikes evaluated together, their running sums fit in L1
+
+    // Prices at count strikes K of the same expiry. The characteristic function is evaluated once per expiry
+    // and model (cached per thread), each strike then costs terms multiply-adds. NaN where K is invalid,
+    // everywhere for invalid other inputs or fewer than 8 terms.
+    static void strip(bool put, double S, const double* K, int count, double r, double q, double T, const Model& model, double* out, int terms = COS_TERMS);
+
+    // A strip of one
+    static double price(bool put, double S, double K, double r, double q, double T, const Model& model, int terms = COS_TERMS);
+};
+
+#endif // HESTON_H
@@ -0,0 +1,194 @@
+#include "kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <unordered_map>
+#include "fastmath.h"
+#include "functions.h"
+
+Kernels::Kernels() {}
+
+namespace {
+
+// Plotted quantity of each surface, matches SurfaceConfig::zVal
+constexpr char quantityOf(Surface::SurfaceMode mode) {
+    switch (mode) {
+    case Surface::SurfaceMode::SKP:
+    case Surface::SurfaceMode::SIP:
+    case Surface::SurfaceMode::STP: return 'P';
+    case Surface::SurfaceMode::SID:
+    case Surface::SurfaceMode::STD: return 'D';
+    case Surface::SurfaceMode::STG: return 'G';
+    case Surface::SurfaceMode::STV: return 'V';
+    case Surface::SurfaceMode::STH: return 'H';
+    case Surface::SurfaceMode::STO: return 'O';
+    case Surface::SurfaceMode::STM: return 'M';
+    case Surface::SurfaceMode::STAP:
+    case Surface::SurfaceMode::STAD:
+    case Surface::SurfaceMode::STAG:
+    case Surface::SurfaceMode::STAH:
+    case Surface::SurfaceMode::KTXP: return 0; // American and Heston surfaces, no closed form to specialize
+    }
+    return 0;
+}
+
+// N(x) through the selected backend, the approximations inline so that rows can vectorize.
+// Real = float only exists with the FAST backend.
+template <Functions::Cdf C, typename Real>
+BATCH_INLINE Real cdf(Real x) {
+    if constexpr (C == Functions::Cdf::EXACT) {
+        return Functions::computeN(x);
+    } else {
+        Real Nx, Nmx;
+        if constexpr (C == Functions::Cdf::RATIONAL)
+            FastMath::normal(x, Nx, Nmx);
+        else
+            FastMath::normalFast(x, Nx, Nmx);
+        return Nx;
+    }
+}
+
+template <Functions::Cdf C, typename Real>
+BATCH_INLINE Real density(Real x) {
+    if constexpr (C == Functions::Cdf::EXACT)
+        return Functions::computeNP(x);
+    else
+        return static_cast<Real>(FastMath::INV_SQRT_2PI) * FastMath::exp(Real(-0.5) * x * x);
+}
+
+// Only N(d1), N(d2) and N'(d1) are evaluated per cell, everything else comes pre-sampled. v(t) reads term t.
+template <char Z, bool Put, Functions::Cdf C, typename Real, typename Terms>
+BATCH_INLINE Real formula(const Terms& v) {
+    using K = Kernels;
+
+    if constexpr (Z == 'M') { // Round trip through the price, as the IV surface always has
+        const double S = v(K::TS), Kp = v(K::TK), r = v(K::TR), q = v(K::TQ), sigma = v(K::TSIGMA), T = v(K::TT);
+        if constexpr (Put)
+            return Functions::computePutIV(S, Kp, r, q, Functions::computePutPrice(S, Kp, r, q, sigma, T), T);
+        else
+            return Functions::computeCallIV(S, Kp, r, q, Functions::computeCallPrice(S, Kp, r, q, sigma, T), T);
+    } else {
+        const Real volT = v(K::TSIGMA) * v(K::TSQRTT);
+        const Real d1 = (v(K::TLOGS) - v(K::TLOGK) + (v(K::TR) - v(K::TQ) + Real(0.5) * v(K::TSIGMA) * v(K::TSIGMA)) * v(K::TT)) / volT;
+        const Real d2 = d1 - volT;
+        const Real S = v(K::TS) * v(K::TDISCQ); // Dividend-discounted spot
+        const Real Kd = v(K::TK) * v(K::TDISCR); // Discounted strike
+
+        if constexpr (Z == 'P') {
+            if constexpr (Put)
+                return Kd * cdf<C>(-d2) - S * cdf<C>(-d1);
+            else
+                return S * cdf<C>(d1) - Kd * cdf<C>(d2);
+        } else if constexpr (Z == 'D') {
+            if constexpr (Put)
+                return v(K::TDISCQ) * (cdf<C>(d1) - Real(1));
+            else
+                return v(K::TDISCQ) * cdf<C>(d1);
+        } else if constexpr (Z == 'G') {
+            return v(K::TDISCQ) * density<C>(d1) / (v(K::TS) * volT);
+        } else if constexpr (Z == 'V') {
+            return S * density<C>(d1) * v(K::TSQRTT);
+        } else if constexpr (Z == 'H') {
+            const Real decay = -(S * density<C>(d1) * v(K::TSIGMA)) / (Real(2) * v(K::TSQRTT));
+            if constexpr (Put)
+                return decay - v(K::TQ) * S * cdf<C>(-d1) + v(K::TR) * Kd * cdf<C>(-d2);
+            else
+                return decay + v(K::TQ) * S * cdf<C>(d1) - v(K::TR) * Kd * cdf<C>(d2);
+        } else {
+            static_assert(Z == 'O', "Unknown surface quantity");
+            if constexpr (Put)
+                return -Kd * v(K::TT) * cdf<C>(-d2);
+            else
+                return Kd * v(K::TT) * cdf<C>(d2);
+        }
+    }
+}
+
+template <char Z, bool Put, Functions::Cdf C, typename Real>
+double cell(const double* terms) {
+    return formula<Z, Put, C, Real>([terms](int t) { return static_cast<Real>(terms[t]); });
+}
+
+// Cells are gathered into term-major chunks so that the formula loop runs over contiguous arrays
+template <char Z, bool Put, Functions::Cdf C, typename Real>
+BATCH_TARGETS
+void row(const Kernels::Row& row) {
+    constexpr int CHUNK = 64;
+    Real v[Kernels::TERM_COUNT][CHUNK];
+    Real out[CHUNK];
+
+    for (int begin = row.xBegin; begin < row.xEnd; begin += CHUNK * row.xStep) {
+        const int count = std::min(CHUNK, (row.xEnd - begin + row.xStep - 1) / row.xStep);
+
+        for (int t = 0; t < Kernels::TERM_COUNT; ++t) {
+            const Kernels::TermView& term = row.terms[t];
+            const double* values = term.values + row.y * term.strideY;
+            if (term.strideX) {
+                for (int j = 0; j < count; ++j)
+                    v[t][j] = static_cast<Real>(values[begin + j * row.xStep]);
+            } else {
+                for (int j = 0; j < count; ++j)
+                    v[t][j] = static_cast<Real>(values[0]); // Fixed along the row
+            }
+        }
+
+        for (int j = 0; j < count; ++j)
+            out[j] = formula<Z, Put, C, Real>([&v, j](int t) { return v[t][j]; });
+
+        for (int j = 0; j < count; ++j)
+            row.out[begin + j * row.xStep] = out[j];
+    }
+}
+
+constexpr int CDF_COUNT = 3; // Functions::Cdf values
+
+struct ModeKernels {
+    Kernels::Kernel put[CDF_COUNT]; // Indexed by Functions::Cdf
+    Kernels::Kernel call[CDF_COUNT];
+    Kernels::Kernel singlePut; // float, FAST backend
+    Kernels::Kernel singleCall;
+};
+
+template <char Z, bool Put, Functions::Cdf C, typename Real = double>
+constexpr Kernels::Kernel kernel() {
+    return { row<Z, Put, C, Real>, cell<Z, Put, C, Real> };
+}
+
+template <Surface::SurfaceMode M>
+ModeKernels kernelsFor() {
+    constexpr char Z = quantityOf(M);
+    using Cdf = Functions::Cdf;
+    using Single = std::conditional_t<Z == 'M', double, float>; // The IV solver needs double
+    return {
+        { kernel<Z, true, Cdf::EXACT>(), kernel<Z, true, Cdf::RATIONAL>(), kernel<Z, true, Cdf::FAST>() },
+        { kernel<Z, false, Cdf::EXACT>(), kernel<Z, false, Cdf::RATIONAL>(), kernel<Z, false, Cdf::FAST>() },
+        kernel<Z, true, Cdf::FAST, Single>(),
+        kernel<Z, false, Cdf::FAST, Single>(),
+    };
+}
+
+const std::unordered_map<Surface::SurfaceMode, ModeKernels> registry = {
+    { Surface::SurfaceMode::SKP, kernelsFor<Surface::SurfaceMode::SKP>() },
+    { Surface::SurfaceMode::SIP, kernelsFor<Surface::SurfaceMode::SIP>() },
+    { Surface::SurfaceMode::STP, kernelsFor<Surface::SurfaceMode::STP>() },
+    { Surface::SurfaceMode::SID, kernelsFor<Surface::SurfaceMode::SID>() },
+    { Surface::SurfaceMode::STD, kernelsFor<Surface::SurfaceMode::STD>() },
+    { Surface::SurfaceMode::STG, kernelsFor<Surface::SurfaceMode::STG>() },
+    { Surface::SurfaceMode::STV, kernelsFor<Surface::SurfaceMode::STV>() },
+    { Surface::SurfaceMode::STH, kernelsFor<Surface::SurfaceMode::STH>() },
+    { Surface::SurfaceMode::STO, kernelsFor<Surface::SurfaceMode::STO>() },
+    { Surface::SurfaceMode::STM, kernelsFor<Surface::SurfaceMode::STM>() },
+};
+
+} // namespace
+
+const Kernels::Kernel* Kernels::lookup(Surface::SurfaceMode surfaceMode, Surface::OptionMode mode, Functions::Cdf cdf, bool single) {
+    auto it = registry.find(surfaceMode);
+    if (it == registry.end())
+        return nullptr;
+    const bool put = mode == Surface::OptionMode::PUT;
+    if (single)
+        return put ? &it->second.singlePut : &it->second.singleCall;
+    const int backend = static_cast<int>(cdf);
+    return put ? &it->second.put[backend] : &it->second.call[backend];
+}
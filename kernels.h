@@ -0,0 +1,45 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "surface.h"
+
+class Kernels
+{
+public:
+    Kernels();
+
+    // Closed-form intermediates a kernel reads per cell, each depends on a subset of (S, K, r, q, sigma, T)
+    enum Term { TS, TK, TR, TQ, TSIGMA, TT, TLOGS, TLOGK, TSQRTT, TDISCQ, TDISCR, TERM_COUNT };
+
+    // A term sampled once per column (x), once per row (y) or once per grid; value at (x, y) is values[x * strideX + y * strideY]
+    struct TermView {
+        const double* values;
+        int strideX;
+        int strideY;
+    };
+
+    // Cells xBegin, xBegin + xStep, ... < xEnd of row y, written to out[x]
+    struct Row {
+        const TermView* terms; // TERM_COUNT views
+        int y;
+        int xBegin;
+        int xEnd;
+        int xStep;
+        double* out;
+    };
+
+    using RowFn = void (*)(const Row& row);
+    using CellFn = double (*)(const double* terms); // terms[TERM_COUNT] for one cell
+
+    // One instantiation per (surface mode, option mode, CDF backend, precision), the formula, put/call
+    // branch and normal CDF are resolved at compile time
+    struct Kernel {
+        RowFn row;
+        CellFn cell;
+    };
+
+    // single selects the float kernel, which always uses the FAST backend (nothing finer survives float). nullptr if none.
+    static const Kernel* lookup(Surface::SurfaceMode surfaceMode, Surface::OptionMode mode, Functions::Cdf cdf, bool single = false);
+};
+
+#endif // KERNELS_H
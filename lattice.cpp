@@ -0,0 +1,262 @@
+#include "lattice.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "fastmath.h"
+#include "functions.h"
+
+Lattice::Lattice() {}
+
+namespace {
+
+using Greeks = Lattice::Greeks;
+
+// Black-Scholes over the last step dt, in place of the kinked payoff the lattice would otherwise start from
+// (Broadie & Detemple, 1996). It takes the odd-even oscillation out of CRR and the trinomial.
+struct LastStep {
+    double K;
+    double logK;
+    double discR; // exp(-r dt)
+    double discQ; // exp(-q dt)
+    double drift; // (r - q + sigma^2 / 2) dt
+    double volT; // sigma sqrt(dt)
+
+    LastStep(double K, double r, double q, double sigma, double dt) :
+        K(K), logK(std::log(K)), discR(std::exp(-r * dt)), discQ(std::exp(-q * dt)),
+        drift((r - q + 0.5 * sigma * sigma) * dt), volT(sigma * std::sqrt(dt)) {}
+
+    template <bool Put>
+    BATCH_INLINE double european(double S) const {
+        const double d1 = (FastMath::log(S) - logK + drift) / volT;
+        double N1, Nm1, N2, Nm2;
+        FastMath::normal(d1, N1, Nm1);
+        FastMath::normal(d1 - volT, N2, Nm2);
+        return Put ? K * discR * Nm2 - S * discQ * Nm1 : S * discQ * N1 - K * discR * N2;
+    }
+
+    // Limit of european() more than a few volT away from K
+    template <bool Put>
+    BATCH_INLINE double intrinsic(double S) const {
+        return std::max(Put ? K * discR - S * discQ : S * discQ - K * discR, 0.0);
+    }
+};
+
+constexpr double SMOOTH_REACH = 10.0; // volT either side of K where the last step needs the full formula
+constexpr double EXERCISED = 1e-9; // Prices within this fraction of K above the payoff count as exercised, the spots carry rounding
+
+template <bool Put>
+BATCH_INLINE double exercise(double S, double K) {
+    return Put ? K - S : S - K;
+}
+
+// The value held at spot S, exercised instead where that is worth more if the option is American
+template <bool Put, bool American>
+BATCH_INLINE double settle(double hold, double S, double K) {
+    return American ? std::max(hold, exercise<Put>(S, K)) : hold;
+}
+
+// value[m] = settle(Black-Scholes over the last step) at count spots, log-spaced by logStep. Only the nodes
+// within SMOOTH_REACH volT of K pay for the formula, the rest take its limit.
+template <bool Put, bool American = true>
+BATCH_TARGETS
+void smoothStep(const LastStep& smooth, const double* spot, double* value, int count, double logStep) {
+    for (int m = 0; m < count; ++m)
+        value[m] = settle<Put, American>(smooth.intrinsic<Put>(spot[m]), spot[m], smooth.K);
+
+    const double centre = (smooth.logK - std::log(spot[0])) / logStep;
+    const double reach = SMOOTH_REACH * smooth.volT / logStep + 1.0;
+    const int from = static_cast<int>(std::max(0.0, std::floor(centre - reach)));
+    const int to = static_cast<int>(std::min(static_cast<double>(count), std::ceil(centre + reach) + 1.0));
+    for (int m = from; m < to; ++m)
+        value[m] = settle<Put, American>(smooth.european<Put>(spot[m]), spot[m], smooth.K);
+}
+
+// Peizer-Pratt method 2 inversion, the probability of z standard deviations over n steps
+double peizerPratt(double z, int n) {
+    const double a = z / (n + 1.0 / 3.0 + 0.1 / (n + 1));
+    return 0.5 + std::copysign(0.5, z) * std::sqrt(1.0 - std::exp(-a * a * (n + 1.0 / 6.0)));
+}
+
+// Price from node (0, 0), delta and gamma from steps 1 and 2, theta from the node of step 2 nearest S, carried
+// back to S along delta and gamma where the tree is not centred on it. American false gives the European
+// option on the same tree.
+template <bool Put, bool American = true>
+BATCH_TARGETS
+Greeks binomial(double S, double K, double r, double q, double sigma, double T, bool leisenReimer, int steps) {
+    const double dt = T / steps;
+    const double growth = std::exp((r - q) * dt);
+    double u, d, p;
+    if (leisenReimer) {
+        const double volT = sigma * std::sqrt(T);
+        const double d1 = (std::log(S / K) + (r - q + 0.5 * sigma * sigma) * T) / volT;
+        p = peizerPratt(d1 - volT, steps);
+        u = growth * peizerPratt(d1, steps) / p;
+        d = (growth - p * u) / (1.0 - p);
+    } else {
+        u = std::exp(sigma * std::sqrt(dt));
+        d = 1.0 / u;
+        p = (growth - d) / (u - d);
+    }
+    const double disc = std::exp(-r * dt);
+    const double up = disc * p;
+    const double down = disc * (1.0 - p);
+    const double inverseD = 1.0 / d;
+
+    // Node i of step j has i up moves, S u^i d^(j - i). Going back a step divides every spot by d.
+    thread_local std::vector<double> value, spot;
+    value.resize(steps + 1);
+    spot.resize(steps + 1);
+
+    const int last = leisenReimer ? steps : steps - 1; // Leisen-Reimer needs no smoothing, it is centred on K
+    const double ratio = u / d;
+    spot[0] = S * std::pow(d, last);
+    for (int i = 1; i <= last; ++i)
+        spot[i] = spot[i - 1] * ratio;
+    if (leisenReimer) {
+        for (int i = 0; i <= last; ++i)
+            value[i] = std::max(exercise<Put>(spot[i], K), 0.0);
+    } else {
+        smoothStep<Put, American>(LastStep(K, r, q, sigma, dt), spot.data(), value.data(), last + 1, std::log(ratio));
+    }
+
+    double v1[2], s1[2], v2[3], s2[3];
+    for (int j = last - 1; j >= 0; --j) {
+        double* v = value.data();
+        double* s = spot.data();
+        for (int i = 0; i <= j; ++i) {
+            s[i] *= inverseD;
+            v[i] = settle<Put, American>(up * v[i + 1] + down * v[i], s[i], K);
+        }
+        if (j == 2)
+            std::copy_n(value.begin(), 3, v2), std::copy_n(spot.begin(), 3, s2);
+        else if (j == 1)
+            std::copy_n(value.begin(), 2, v1), std::copy_n(spot.begin(), 2, s1);
+    }
+
+    Greeks greeks;
+    greeks.price = value[0];
+    greeks.delta = (v1[1] - v1[0]) / (s1[1] - s1[0]);
+    greeks.gamma = ((v2[2] - v2[1]) / (s2[2] - s2[1]) - (v2[1] - v2[0]) / (s2[1] - s2[0])) / (0.5 * (s2[2] - s2[0]));
+    const double shift = s2[1] - S;
+    greeks.theta = (v2[1] - greeks.delta * shift - 0.5 * greeks.gamma * shift * shift - value[0]) / (2.0 * dt);
+    return greeks;
+}
+
+// Trinomial moves of one step on the log grid, spacing dx = sigma sqrt(3 dt) (Boyle, 1986 as in Hull)
+struct Trinomial {
+    double dx;
+    double up; // Discounted probabilities
+    double middle;
+    double down;
+
+    Trinomial(double r, double q, double sigma, double dt) {
+        const double disc = std::exp(-r * dt);
+        const double skew = (r - q - 0.5 * sigma * sigma) * std::sqrt(dt / (12.0 * sigma * sigma));
+        dx = sigma * std::sqrt(3.0 * dt);
+        up = disc * (1.0 / 6.0 + skew);
+        middle = disc * (2.0 / 3.0);
+        down = disc * (1.0 / 6.0 - skew);
+    }
+};
+
+// Backward induction over a band of nodes that narrows by one on each side per step. gain[m] is the exercise
+// value of node m of the widest band; a step back reads nodes m, m + 1, m + 2 and writes m, so the band of
+// step j starts at node (steps - j) of the widest one. Leaves step 0 in value, step 1 in previous.
+template <bool Put>
+BATCH_TARGETS
+void induct(const Trinomial& move, const double* gain, const double* spot, int width, int steps, const LastStep& smooth, double* value, double* previous) {
+    smoothStep<Put>(smooth, spot + 1, value, width - 2, move.dx); // Step steps - 1
+
+    for (int j = steps - 2; j >= 0; --j) {
+        const int count = width - 2 * (steps - j);
+        const double* exercise = gain + (steps - j);
+        if (j == 0)
+            std::copy_n(value, count + 2, previous);
+        for (int m = 0; m < count; ++m)
+            value[m] = std::max(move.down * value[m] + move.middle * value[m + 1] + move.up * value[m + 2], exercise[m]);
+    }
+}
+
+template <bool Put>
+Greeks trinomial(double S, double K, double r, double q, double sigma, double T, int steps) {
+    const double dt = T / steps;
+    const Trinomial move(r, q, sigma, dt);
+
+    // Nodes S e^(k dx), k = -steps..steps
+    const int width = 2 * steps + 1;
+    thread_local std::vector<double> value, previous, gain, spot;
+    value.resize(width);
+    previous.resize(width);
+    gain.resize(width);
+    spot.resize(width);
+    const double rise = std::exp(move.dx);
+    spot[0] = S * std::exp(-steps * move.dx);
+    for (int m = 1; m < width; ++m)
+        spot[m] = spot[m - 1] * rise;
+    spot[steps] = S; // Exact at the root, the Greeks divide by differences around it
+    for (int m = 0; m < width; ++m)
+        gain[m] = exercise<Put>(spot[m], K);
+    induct<Put>(move, gain.data(), spot.data(), width, steps, LastStep(K, r, q, sigma, dt), value.data(), previous.data());
+
+    // Step 1 is previous[0..2] at S e^-dx, S, S e^dx
+    const double sDown = spot[steps - 1], sUp = spot[steps + 1];
+    Greeks greeks;
+    greeks.price = value[0];
+    greeks.delta = (previous[2] - previous[0]) / (sUp - sDown);
+    greeks.gamma = ((previous[2] - previous[1]) / (sUp - S) - (previous[1] - previous[0]) / (S - sDown)) / (0.5 * (sUp - sDown));
+    greeks.theta = (previous[1] - value[0]) / dt;
+    return greeks;
+}
+
+// The control variate adds the Black-Scholes Greeks to a difference of two lattices, so next to the exercise
+// boundary it can overshoot what any American option satisfies: V >= max(exercise, 0), |delta| <= 1 with the
+// sign of the payoff, gamma >= 0
+Greeks bound(Greeks greeks, bool put, double S, double K) {
+    greeks.price = std::max(greeks.price, std::max(put ? K - S : S - K, 0.0));
+    greeks.delta = put ? std::min(std::max(greeks.delta, -1.0), 0.0) : std::min(std::max(greeks.delta, 0.0), 1.0);
+    greeks.gamma = std::max(greeks.gamma, 0.0);
+    return greeks;
+}
+
+// CRR with a control variate (Hull & White, 1988): the European option on the same tree has the same
+// discretisation error as the American one but a known exact value, so the difference is taken off
+template <bool Put>
+Greeks controlled(double S, double K, double r, double q, double sigma, double T, int steps) {
+    const Greeks american = binomial<Put>(S, K, r, q, sigma, T, false, steps);
+    if (american.price <= exercise<Put>(S, K) + EXERCISED * K)
+        return american; // Exercised now, exact on the lattice already
+    const Greeks european = binomial<Put, false>(S, K, r, q, sigma, T, false, steps);
+    const Functions::Greeks exact = Functions::computeGreeks(S, K, r, q, sigma, T);
+    return {
+        american.price - european.price + (Put ? exact.putPrice : exact.callPrice),
+        american.delta - european.delta + (Put ? exact.putDelta : exact.callDelta),
+        american.gamma - european.gamma + exact.gamma,
+        american.theta - european.theta + (Put ? exact.putTheta : exact.callTheta),
+    };
+}
+
+template <bool Put>
+Greeks single(double S, double K, double r, double q, double sigma, double T, Lattice::Method method, int steps) {
+    switch (method) {
+    case Lattice::Method::CRR: return controlled<Put>(S, K, r, q, sigma, T, steps);
+    case Lattice::Method::LEISEN_REIMER: return binomial<Put>(S, K, r, q, sigma, T, true, steps | 1);
+    case Lattice::Method::TRINOMIAL: return trinomial<Put>(S, K, r, q, sigma, T, steps);
+    }
+    return { NAN, NAN, NAN, NAN };
+}
+
+bool valid(double S, double K, double sigma, double T, int steps) {
+    return S > 0 && K > 0 && sigma > 0 && T > 0 && std::isfinite(S * K * sigma * T) && steps >= 4;
+}
+
+} // namespace
+
+Lattice::Greeks Lattice::american(bool put, double S, double K, double r, double q, double sigma, double T, Method method, int steps) {
+    if (!valid(S, K, sigma, T, steps) || !std::isfinite(r) || !std::isfinite(q))
+        return { NAN, NAN, NAN, NAN };
+
+    // No Richardson: near the exercise boundary the American error oscillates in N, and extrapolating across
+    // two lattices amplifies that instead of cancelling it
+    const Greeks greeks = put ? single<true>(S, K, r, q, sigma, T, method, steps) : single<false>(S, K, r, q, sigma, T, method, steps);
+    return bound(greeks, put, S, K);
+}
@@ -0,0 +1,32 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+// American options on binomial and trinomial lattices under the model of Functions. Backward induction runs
+// in place over one rolling array, so memory is O(steps) per option.
+class Lattice
+{
+public:
+    Lattice();
+
+    enum class Method {
+        CRR, // Cox-Ross-Rubinstein binomial, Black-Scholes over the last step, the European tree as a control variate
+        LEISEN_REIMER, // Binomial centred on the strike (Peizer-Pratt inversion), odd N
+        TRINOMIAL, // Boyle trinomial, Black-Scholes over the last step
+    };
+
+    // Price and the Greeks read off the first lattice steps, theta per year
+    struct Greeks {
+        double price;
+        double delta;
+        double gamma;
+        double theta;
+    };
+
+    static constexpr int STEPS = 128; // Default steps of american(), CRR runs a European lattice of as many
+
+    // Exercisable at every step. NaN for invalid inputs or fewer than 4 steps. The error falls about as 1 / steps
+    // for every method, smallest for CRR.
+    static Greeks american(bool put, double S, double K, double r, double q, double sigma, double T, Method method = Method::CRR, int steps = STEPS);
+};
+
+#endif // LATTICE_H
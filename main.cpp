@@ -3,8 +3,6 @@
 #include "component.h"
 #include "compute.h"
 
-#define SAMPLES 200
-
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
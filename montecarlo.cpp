@@ -0,0 +1,510 @@
+#include "montecarlo.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "fastmath.h"
+#include "functions.h"
+#include "threadpool.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+MonteCarlo::MonteCarlo() {}
+
+namespace {
+
+constexpr int LANES = MonteCarlo::BLOCK_PATHS;
+
+// 1 if an odd number of bits of x are set
+inline uint32_t parity32(uint32_t x) {
+#if defined(__GNUC__)
+    return static_cast<uint32_t>(__builtin_parity(x));
+#elif defined(_MSC_VER)
+    return __popcnt(x) & 1;
+#else
+    uint32_t parity = 0;
+    for (; x; x &= x - 1)
+        parity ^= 1;
+    return parity;
+#endif
+}
+
+// Index of the lowest set bit, x not 0
+inline int countTrailingZeros64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int count = 0;
+    for (; !(x & 1); x >>= 1)
+        ++count;
+    return count;
+#endif
+}
+
+// 52 random bits as a double in (0, 1): [1, 2) through the exponent, shifted down and off 0
+BATCH_INLINE double uniform(uint32_t hi, uint32_t lo) {
+    const uint64_t bits = 0x3FF0000000000000ull | (uint64_t(hi) << 20) | (lo >> 12);
+    double value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value - 1.0 + 0x1p-53;
+}
+
+// Philox4x32-10 (Salmon et al., 2011). Counter-based, the numbers of (block, step) are a pure function of
+// the seed and that counter, so a block draws the same normals on whichever thread runs it.
+// Fills z[0, count) with standard normals, count even.
+BATCH_INLINE void normals(unsigned long long seed, long long block, int step, double* z, int count) {
+    const int half = count / 2;
+    for (int i = 0; i < half; ++i) {
+        uint32_t c0 = static_cast<uint32_t>(i);
+        uint32_t c1 = static_cast<uint32_t>(step);
+        uint32_t c2 = static_cast<uint32_t>(block);
+        uint32_t c3 = static_cast<uint32_t>(static_cast<unsigned long long>(block) >> 32);
+        uint32_t k0 = static_cast<uint32_t>(seed);
+        uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t p0 = uint64_t(0xD2511F53u) * c0;
+            const uint64_t p1 = uint64_t(0xCD9E8D57u) * c2;
+            const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c0 = n0;
+            c1 = static_cast<uint32_t>(p1);
+            c2 = n2;
+            c3 = static_cast<uint32_t>(p0);
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        z[i] = FastMath::inverseNormal(uniform(c0, c1));
+        z[i + half] = FastMath::inverseNormal(uniform(c2, c3));
+    }
+}
+
+constexpr int SOBOL_BITS = 32;
+
+uint64_t splitMix(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// a * b modulo poly over GF(2), degree s, coefficients as bits
+uint32_t multiply(uint32_t a, uint32_t b, uint32_t poly, int s) {
+    uint32_t product = 0;
+    for (; b; b >>= 1) {
+        if (b & 1)
+            product ^= a;
+        a <<= 1;
+        if (a >> s & 1)
+            a ^= poly;
+    }
+    return product;
+}
+
+uint32_t power(uint32_t exponent, uint32_t poly, int s) {
+    uint32_t result = 1, base = 2; // x
+    for (; exponent; exponent >>= 1) {
+        if (exponent & 1)
+            result = multiply(result, base, poly, s);
+        base = multiply(base, base, poly, s);
+    }
+    return result;
+}
+
+// x has order exactly 2^s - 1 modulo poly: x^(2^s - 1) = 1, and no x^((2^s - 1) / p) for a prime p of it
+bool primitive(uint32_t poly, int s) {
+    const uint32_t period = (1u << s) - 1;
+    if (power(period, poly, s) != 1)
+        return false;
+    uint32_t rest = period;
+    for (uint32_t p = 2; p * p <= rest; ++p) {
+        if (rest % p)
+            continue;
+        if (power(period / p, poly, s) == 1)
+            return false;
+        while (rest % p == 0)
+            rest /= p;
+    }
+    return rest == 1 || power(period / rest, poly, s) != 1;
+}
+
+using Directions = std::array<uint32_t, SOBOL_BITS>; // v_k, first digit in the top bit
+
+// Initial direction numbers m_1..m_s of dimensions 2..21, after Joe & Kuo (2008)
+const std::vector<std::vector<uint32_t>> initialNumbers = {
+    { 1 }, { 1, 3 }, { 1, 3, 1 }, { 1, 1, 1 }, { 1, 1, 3, 3 }, { 1, 3, 5, 13 }, { 1, 1, 5, 5, 17 },
+    { 1, 1, 5, 5, 5 }, { 1, 1, 7, 11, 19 }, { 1, 1, 5, 1, 1 }, { 1, 1, 1, 3, 11 }, { 1, 3, 5, 5, 31 },
+    { 1, 3, 3, 9, 7, 49 }, { 1, 1, 1, 15, 21, 21 }, { 1, 3, 1, 13, 27, 49 }, { 1, 1, 1, 15, 7, 5 },
+    { 1, 3, 1, 15, 13, 25 }, { 1, 1, 5, 5, 19, 61 }, { 1, 3, 7, 11, 23, 15, 103 },
+};
+
+// Direction numbers of the first SOBOL_DIMENSIONS dimensions. Dimension 1 is van der Corput, the others
+// take the primitive polynomials in order of degree then coefficients, the same order as Joe & Kuo.
+// Past their table the initial numbers are fixed pseudo-random odd m_k < 2^k, any of which gives a valid
+// Sobol dimension; the bridge puts most of the variance into the leading ones.
+std::vector<Directions> buildDirections() {
+    std::vector<Directions> table;
+    table.reserve(MonteCarlo::SOBOL_DIMENSIONS);
+    Directions first;
+    for (int k = 0; k < SOBOL_BITS; ++k)
+        first[k] = 1u << (SOBOL_BITS - 1 - k);
+    table.push_back(first);
+
+    uint64_t state = 0x5EED5EED5EED5EEDull;
+    for (int s = 1; static_cast<int>(table.size()) < MonteCarlo::SOBOL_DIMENSIONS; ++s) {
+        for (uint32_t a = 0; a < (1u << (s - 1)) && static_cast<int>(table.size()) < MonteCarlo::SOBOL_DIMENSIONS; ++a) {
+            if (!primitive((1u << s) | (a << 1) | 1u, s))
+                continue;
+
+            const size_t known = table.size() - 1;
+            Directions v;
+            for (int k = 0; k < s && k < SOBOL_BITS; ++k) {
+                const uint32_t m = known < initialNumbers.size() ? initialNumbers[known][k]
+                                                                 : static_cast<uint32_t>(splitMix(state) & ((2ull << k) - 1)) | 1u;
+                v[k] = m << (SOBOL_BITS - 1 - k);
+            }
+            // v_k = a_1 v_{k-1} ^ ... ^ a_{s-1} v_{k-s+1} ^ v_{k-s} ^ (v_{k-s} >> s)
+            for (int k = s; k < SOBOL_BITS; ++k) {
+                uint32_t value = v[k - s] ^ (v[k - s] >> s);
+                for (int i = 1; i < s; ++i)
+                    if (a >> (s - 1 - i) & 1)
+                        value ^= v[k - i];
+                v[k] = value;
+            }
+            table.push_back(v);
+        }
+    }
+    return table;
+}
+
+const std::vector<Directions>& directions() {
+    static const std::vector<Directions> table = buildDirections();
+    return table;
+}
+
+// One randomization of the first dims dimensions: a random linear scramble (Matousek, 1998), each digit
+// XORed with a random subset of the digits before it, then a random digital shift. Every replicate is
+// still a (t, s)-sequence, and unbiased on its own.
+void scramble(unsigned long long seed, int replicate, int dims, uint32_t* scrambled, uint32_t* shifts) {
+    uint64_t state = seed ^ (0xA0761D6478BD642Full * static_cast<uint64_t>(replicate + 1));
+    for (int d = 0; d < dims; ++d) {
+        uint32_t rows[SOBOL_BITS]; // Row j mixes digit j (bit 31 - j) with the random digits above it
+        for (int j = 0; j < SOBOL_BITS; ++j) {
+            const uint32_t above = static_cast<uint32_t>(~((uint64_t(1) << (SOBOL_BITS - j)) - 1));
+            rows[j] = (1u << (SOBOL_BITS - 1 - j)) | (static_cast<uint32_t>(splitMix(state)) & above);
+        }
+        const Directions& v = directions()[d];
+        for (int k = 0; k < SOBOL_BITS; ++k) {
+            uint32_t value = 0;
+            for (int j = 0; j < SOBOL_BITS; ++j)
+                value |= parity32(v[k] & rows[j]) << (SOBOL_BITS - 1 - j);
+            scrambled[d * SOBOL_BITS + k] = value;
+        }
+        shifts[d] = static_cast<uint32_t>(splitMix(state));
+    }
+}
+
+// Brownian bridge over the monitoring dates 1..steps (in units of dt, Jackel 2002): point[0] = steps - 1
+// comes first, from W(T) alone, every later point halves an open interval between two known ones
+struct Bridge {
+    std::vector<int> point;
+    std::vector<int> left; // Known point before, -1 for W(0) = 0
+    std::vector<int> right; // Known point after
+    std::vector<double> leftWeight;
+    std::vector<double> rightWeight;
+    std::vector<double> deviation;
+
+    explicit Bridge(int steps)
+        : point(steps), left(steps, -1), right(steps), leftWeight(steps, 0.0), rightWeight(steps, 0.0), deviation(steps) {
+        std::vector<bool> known(steps, false);
+        known[steps - 1] = true;
+        point[0] = steps - 1;
+        right[0] = steps - 1;
+        deviation[0] = std::sqrt(static_cast<double>(steps));
+        for (int i = 1, j = 0; i < steps; ++i) {
+            while (known[j])
+                ++j;
+            int k = j;
+            while (!known[k])
+                ++k;
+            const int l = j + (k - 1 - j) / 2;
+            known[l] = true;
+            // Times t = index + 1, the open interval is (j - 1, k), its left end W(0) when j = 0
+            const double tLeft = j;
+            const double tPoint = l + 1;
+            const double tRight = k + 1;
+            point[i] = l;
+            left[i] = j - 1;
+            right[i] = k;
+            leftWeight[i] = (tRight - tPoint) / (tRight - tLeft);
+            rightWeight[i] = (tPoint - tLeft) / (tRight - tLeft);
+            deviation[i] = std::sqrt((tPoint - tLeft) * (tRight - tPoint) / (tRight - tLeft));
+            j = k + 1 < steps ? k + 1 : 0;
+        }
+    }
+};
+
+// A replicate's point set and the bridge that turns its points into steps
+struct Sobol {
+    const uint32_t* directions; // SOBOL_BITS per dimension, scrambled
+    const uint32_t* shifts; // One per dimension
+    const Bridge* bridge;
+};
+
+// Shocks of paths [block * count, (block + 1) * count) of a replicate, shocks[step * LANES + lane]:
+// Sobol point per path, dimension i drives bridge point i, W differenced into unit steps
+BATCH_INLINE void sobolShocks(const Sobol& sobol, int steps, long long block, int count, double* shocks, double* normal) {
+    const uint64_t first = static_cast<uint64_t>(block) * count;
+    uint32_t bits[LANES];
+    for (int d = 0; d < steps; ++d) {
+        const uint32_t* v = sobol.directions + d * SOBOL_BITS;
+        // Gray code order: point n + 1 is point n with the direction of the lowest zero bit of n flipped in
+        uint32_t x = sobol.shifts[d];
+        uint64_t gray = first ^ (first >> 1);
+        for (int k = 0; gray; ++k, gray >>= 1)
+            if (gray & 1)
+                x ^= v[k];
+        for (int i = 0; i < count; ++i) {
+            bits[i] = x;
+            x ^= v[countTrailingZeros64(first + i + 1) & (SOBOL_BITS - 1)];
+        }
+        double* row = normal + d * LANES;
+        for (int i = 0; i < count; ++i)
+            row[i] = FastMath::inverseNormal((bits[i] + 0.5) * 0x1p-32);
+    }
+
+    const Bridge& bridge = *sobol.bridge;
+    for (int i = 0; i < steps; ++i) {
+        double* out = shocks + bridge.point[i] * LANES;
+        const double* z = normal + i * LANES;
+        const double* right = shocks + bridge.right[i] * LANES;
+        const double wr = bridge.rightWeight[i], sd = bridge.deviation[i];
+        if (i == 0) {
+            for (int j = 0; j < count; ++j)
+                out[j] = sd * z[j];
+        } else if (bridge.left[i] < 0) {
+            for (int j = 0; j < count; ++j)
+                out[j] = wr * right[j] + sd * z[j];
+        } else {
+            const double* left = shocks + bridge.left[i] * LANES;
+            const double wl = bridge.leftWeight[i];
+            for (int j = 0; j < count; ++j)
+                out[j] = wl * left[j] + wr * right[j] + sd * z[j];
+        }
+    }
+    for (int step = steps - 1; step > 0; --step) {
+        double* out = shocks + step * LANES;
+        const double* previous = out - LANES;
+        for (int j = 0; j < count; ++j)
+            out[j] -= previous[j];
+    }
+}
+
+// Sample moments of the payoff y and the control x, merged pairwise (Chan et al.) so that large path
+// counts don't lose the variance to cancellation
+struct Moments {
+    double n = 0;
+    double meanY = 0;
+    double meanX = 0;
+    double m2Y = 0; // Sum of squared deviations
+    double m2X = 0;
+    double cXY = 0; // Sum of products of deviations
+
+    void merge(const Moments& other) {
+        if (other.n == 0)
+            return;
+        const double total = n + other.n;
+        const double dy = other.meanY - meanY;
+        const double dx = other.meanX - meanX;
+        const double weight = n * other.n / total;
+        meanY += dy * other.n / total;
+        meanX += dx * other.n / total;
+        m2Y += other.m2Y + dy * dy * weight;
+        m2X += other.m2X + dx * dx * weight;
+        cXY += other.cXY + dx * dy * weight;
+        n = total;
+    }
+};
+
+struct Model {
+    MonteCarlo::Contract contract;
+    double S;
+    double K;
+    double drift; // Log increment per step without the shock, (r - q - sigma^2 / 2) dt
+    double vol; // sigma sqrt(dt)
+    double discount; // exp(-rT)
+    unsigned long long seed;
+    bool antithetic;
+};
+
+// Simulates paths [block * LANES, (block + 1) * LANES), lanes side by side so every step loop vectorizes.
+// With sobol, the block's paths of that replicate, all shocks drawn up front for the bridge.
+BATCH_TARGETS
+Moments simulateBlock(const Model& m, long long block, const Sobol* sobol) {
+    using Payoff = MonteCarlo::Payoff;
+    const Payoff payoff = m.contract.payoff;
+    const bool put = m.contract.put;
+    const bool up = payoff == Payoff::UP_AND_OUT || payoff == Payoff::UP_AND_IN;
+    const bool barrier = up || payoff == Payoff::DOWN_AND_OUT || payoff == Payoff::DOWN_AND_IN;
+    const int draws = m.antithetic ? LANES / 2 : LANES;
+
+    double z[LANES];
+    thread_local std::vector<double> shocks, normal;
+    if (sobol) {
+        shocks.resize(static_cast<size_t>(m.contract.steps) * LANES);
+        normal.resize(shocks.size());
+        sobolShocks(*sobol, m.contract.steps, block, draws, shocks.data(), normal.data());
+    }
+
+    double S[LANES];
+    double level[LANES]; // Running sum (ASIAN), extreme (LOOKBACK) or barrier touched, 0 or 1
+    for (int i = 0; i < LANES; ++i) {
+        S[i] = m.S;
+        level[i] = payoff == Payoff::LOOKBACK ? m.S : 0.0;
+    }
+
+    for (int step = 0; step < m.contract.steps; ++step) {
+        if (sobol)
+            std::copy_n(shocks.data() + static_cast<size_t>(step) * LANES, draws, z);
+        else
+            normals(m.seed, block, step, z, draws);
+        if (m.antithetic)
+            for (int i = 0; i < draws; ++i)
+                z[i + draws] = -z[i];
+
+        for (int i = 0; i < LANES; ++i)
+            S[i] *= FastMath::exp(m.drift + m.vol * z[i]);
+
+        if (payoff == Payoff::ASIAN) {
+            for (int i = 0; i < LANES; ++i)
+                level[i] += S[i];
+        } else if (payoff == Payoff::LOOKBACK) {
+            for (int i = 0; i < LANES; ++i)
+                level[i] = put ? std::min(level[i], S[i]) : std::max(level[i], S[i]);
+        } else if (barrier) {
+            const double H = m.contract.barrier;
+            for (int i = 0; i < LANES; ++i)
+                level[i] = (up ? S[i] >= H : S[i] <= H) ? 1.0 : level[i];
+        }
+    }
+
+    // Discounted payoff y and European control x per lane
+    double y[LANES];
+    double x[LANES];
+    const double averaging = 1.0 / m.contract.steps;
+    const bool knockIn = payoff == Payoff::UP_AND_IN || payoff == Payoff::DOWN_AND_IN;
+    for (int i = 0; i < LANES; ++i) {
+        const double vanilla = m.discount * (put ? std::max(m.K - S[i], 0.0) : std::max(S[i] - m.K, 0.0));
+        double underlying = S[i];
+        if (payoff == Payoff::ASIAN)
+            underlying = level[i] * averaging;
+        else if (payoff == Payoff::LOOKBACK)
+            underlying = level[i];
+        double value = m.discount * (put ? std::max(m.K - underlying, 0.0) : std::max(underlying - m.K, 0.0));
+        if (barrier)
+            value = (level[i] != 0.0) == knockIn ? value : 0.0;
+        y[i] = value;
+        x[i] = vanilla;
+    }
+
+    // An antithetic pair is one sample, the mean of its two paths
+    const int samples = m.antithetic ? LANES / 2 : LANES;
+    if (m.antithetic) {
+        for (int i = 0; i < samples; ++i) {
+            y[i] = 0.5 * (y[i] + y[i + samples]);
+            x[i] = 0.5 * (x[i] + x[i + samples]);
+        }
+    }
+
+    Moments moments;
+    double sumY = 0, sumX = 0;
+    for (int i = 0; i < samples; ++i) {
+        sumY += y[i];
+        sumX += x[i];
+    }
+    moments.n = samples;
+    moments.meanY = sumY / samples;
+    moments.meanX = sumX / samples;
+    for (int i = 0; i < samples; ++i) {
+        const double dy = y[i] - moments.meanY;
+        const double dx = x[i] - moments.meanX;
+        moments.m2Y += dy * dy;
+        moments.m2X += dx * dx;
+        moments.cXY += dx * dy;
+    }
+    return moments;
+}
+
+} // namespace
+
+MonteCarlo::Estimate MonteCarlo::price(double S, double K, double r, double q, double sigma, double T, const Contract& contract, const Settings& settings) {
+    const bool quasi = settings.sequence == Sequence::SOBOL;
+    if (!(S > 0 && K > 0 && sigma > 0 && T > 0) || contract.steps < 1 || settings.paths < 1 || (quasi && contract.steps > SOBOL_DIMENSIONS))
+        return { NAN, NAN, 0 };
+
+    const double dt = T / contract.steps;
+    const Model model = { contract, S, K, (r - q - 0.5 * sigma * sigma) * dt, sigma * std::sqrt(dt), std::exp(-r * T), settings.seed, settings.antithetic };
+
+    // SOBOL: blocks of each replicate cover its first points in order, the replicates differ by scrambling
+    const int replicates = quasi ? std::max(2, settings.replicates) : 1;
+    const long long blocksPerReplicate = (settings.paths + replicates * BLOCK_PATHS - 1) / (replicates * BLOCK_PATHS);
+    const long long blocks = blocksPerReplicate * replicates;
+
+    std::vector<uint32_t> scrambled;
+    std::vector<uint32_t> shifts;
+    std::vector<Sobol> sobol;
+    std::unique_ptr<Bridge> bridge;
+    if (quasi) {
+        const int dims = contract.steps;
+        scrambled.resize(static_cast<size_t>(replicates) * dims * SOBOL_BITS);
+        shifts.resize(static_cast<size_t>(replicates) * dims);
+        bridge = std::make_unique<Bridge>(dims);
+        for (int i = 0; i < replicates; ++i) {
+            scramble(settings.seed, i, dims, scrambled.data() + static_cast<size_t>(i) * dims * SOBOL_BITS, shifts.data() + static_cast<size_t>(i) * dims);
+            sobol.push_back({ scrambled.data() + static_cast<size_t>(i) * dims * SOBOL_BITS, shifts.data() + static_cast<size_t>(i) * dims, bridge.get() });
+        }
+    }
+
+    std::vector<Moments> partial(blocks);
+    ThreadPool::instance().parallelFor(static_cast<int>(blocks), [&](int block) {
+        if (quasi)
+            partial[block] = simulateBlock(model, block % blocksPerReplicate, &sobol[block / blocksPerReplicate]);
+        else
+            partial[block] = simulateBlock(model, block, nullptr);
+    });
+
+    // Merged in block order, the same sum whichever thread ran which block
+    std::vector<Moments> replicate(replicates);
+    Moments total;
+    for (long long block = 0; block < blocks; ++block)
+        replicate[block / blocksPerReplicate].merge(partial[block]);
+    for (const Moments& moments : replicate)
+        total.merge(moments);
+
+    // y - beta (x - E[x]) with the variance minimizing beta, E[x] from the closed form. A European payoff is its
+    // own control, beta = 1 would return the closed form with no error and test nothing.
+    const bool controlled = settings.controlVariate && contract.payoff != MonteCarlo::Payoff::EUROPEAN && total.m2X > 0;
+    const double control = !controlled ? 0.0 : contract.put ? Functions::computePutPrice(S, K, r, q, sigma, T) : Functions::computeCallPrice(S, K, r, q, sigma, T);
+    const double beta = controlled ? total.cXY / total.m2X : 0.0;
+
+    const double n = total.n;
+    if (!quasi) {
+        const double varResidual = std::max(0.0, (total.m2Y - beta * total.cXY) / (n - 1));
+        return { total.meanY - beta * (total.meanX - control), std::sqrt(varResidual / n), blocks * BLOCK_PATHS };
+    }
+
+    // QMC points are not independent, only the replicates are: estimate and error from their spread
+    Moments spread;
+    for (const Moments& moments : replicate) {
+        const double estimate = moments.meanY - beta * (moments.meanX - control);
+        spread.merge({ 1, estimate, 0, 0, 0, 0 });
+    }
+    return { spread.meanY, std::sqrt(spread.m2Y / (replicates - 1) / replicates), blocks * BLOCK_PATHS };
+}
@@ -0,0 +1,56 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+// Monte Carlo pricing of path-dependent options under the model of Functions: geometric Brownian motion
+// from S with drift r - q and volatility sigma, discounted at r, to expiry T
+class MonteCarlo
+{
+public:
+    MonteCarlo();
+
+    enum class Payoff {
+        EUROPEAN, // max(S_T - K, 0) for calls, max(K - S_T, 0) for puts, checks against the closed form
+        ASIAN, // Arithmetic average of the monitoring dates in place of S_T
+        UP_AND_OUT, // European payoff, void once a monitoring date is at or above the barrier
+        DOWN_AND_OUT, // European payoff, void once a monitoring date is at or below the barrier
+        UP_AND_IN, // European payoff, only once a monitoring date is at or above the barrier
+        DOWN_AND_IN, // European payoff, only once a monitoring date is at or below the barrier
+        LOOKBACK, // Fixed strike, the highest (calls) or lowest (puts) of S and the monitoring dates in place of S_T
+    };
+
+    struct Contract {
+        Payoff payoff;
+        bool put;
+        double barrier; // Barrier payoffs only
+        int steps; // Monitoring dates, evenly spaced over T, the last one at T
+    };
+
+    enum class Sequence {
+        PSEUDO, // Philox normals, one independent draw per path and step
+        SOBOL, // Scrambled Sobol points, one dimension per step, turned into paths by a Brownian bridge
+    };
+
+    struct Settings {
+        long long paths; // Rounded up to whole blocks of BLOCK_PATHS (SOBOL: split over the replicates)
+        unsigned long long seed; // Same seed, same estimate, whatever the thread count
+        bool antithetic = true; // Each path is paired with its mirror (-z)
+        bool controlVariate = true; // European payoff of the same paths as control, the closed form as its mean (not for EUROPEAN)
+        Sequence sequence = Sequence::PSEUDO;
+        int replicates = 16; // SOBOL: independently scrambled copies of the point set, the standard error is their spread
+    };
+
+    struct Estimate {
+        double price;
+        double standardError; // Of price, from the sample variance (SOBOL: of the replicate estimates)
+        long long paths; // Simulated, antithetic mirrors included
+    };
+
+    static constexpr int BLOCK_PATHS = 256; // Paths simulated together as one parallel task
+    static constexpr int SOBOL_DIMENSIONS = 1024; // Most steps a SOBOL contract can have
+
+    // Blocks run in parallel on ThreadPool::instance(), each draws from its own counter-based RNG stream, or
+    // from its own run of Sobol points. Invalid inputs, or more than SOBOL_DIMENSIONS steps with SOBOL, give NaN.
+    static Estimate price(double S, double K, double r, double q, double sigma, double T, const Contract& contract, const Settings& settings);
+};
+
+#endif // MONTECARLO_H
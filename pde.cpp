@@ -0,0 +1,220 @@
+#include "pde.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+Pde::Pde() {}
+
+namespace {
+
+using Greeks = Pde::Greeks;
+
+constexpr double PENALTY = 1e8; // Weight pinning exercised nodes to the payoff, leaves them about payoff / PENALTY off
+constexpr double EXERCISED = 1e-7; // Nodes within this fraction of K above the payoff count as exercised
+
+// Nodes K + c sinh(xi), c = CLUSTER K, from 0 to far. xi is uniform on either side of 0 so that K is a node.
+void buildNodes(double K, double far, int nodes, double* s) {
+    const double c = Pde::CLUSTER * K;
+    const double low = std::asinh(-K / c), high = std::asinh((far - K) / c);
+    const int left = std::min(std::max(static_cast<int>(std::lround((nodes - 1) * -low / (high - low))), 2), nodes - 3);
+    const int right = nodes - 1 - left;
+    for (int i = 0; i < left; ++i)
+        s[i] = K + c * std::sinh(low * (left - i) / left);
+    s[0] = 0.0;
+    s[left] = K;
+    for (int i = 1; i <= right; ++i)
+        s[left + i] = K + c * std::sinh(high * i / right);
+}
+
+// L V = lower V[i - 1] + diag V[i] + upper V[i + 1] for V_tau = sigma^2 S^2 V_SS / 2 + (r - q) S V_S - r V. Central
+// differences, upwind for the drift where they would give a neighbour a negative weight. At S = 0 only -r V is left.
+// The last node is a Dirichlet boundary and has no row.
+struct Operator {
+    std::vector<double> lower, diag, upper;
+
+    void build(const double* s, int nodes, double r, double q, double sigma) {
+        lower.assign(nodes, 0.0);
+        diag.assign(nodes, -r);
+        upper.assign(nodes, 0.0);
+        const double mu = r - q;
+        for (int i = 1; i < nodes - 1; ++i) {
+            const double hm = s[i] - s[i - 1], hp = s[i + 1] - s[i];
+            const double diffusion = sigma * sigma * s[i] * s[i];
+            double a = diffusion / (hm * (hm + hp));
+            double c = diffusion / (hp * (hm + hp));
+            const double da = -mu * s[i] * hp / (hm * (hm + hp)), dc = mu * s[i] * hm / (hp * (hm + hp));
+            if (a + da >= 0 && c + dc >= 0) {
+                a += da;
+                c += dc;
+            } else if (mu > 0) {
+                c += mu * s[i] / hp;
+            } else {
+                a -= mu * s[i] / hm;
+            }
+            lower[i] = a;
+            upper[i] = c;
+            diag[i] = -(a + c) - r; // Both difference stencils sum to 0
+        }
+    }
+};
+
+struct Scratch {
+    std::vector<double> rhs, factor, solution;
+    std::vector<char> exercised;
+};
+
+// One step of dt: (I - w dt L) V' = (I + (1 - w) dt L) V, w = 1/2 Crank-Nicolson, w = 1 implicit Euler, V' = boundary
+// at the last node. With payoff set, V' >= payoff by penalty iteration (Forsyth & Vetzal, 2002): every node below
+// the payoff gets PENALTY (payoff - V') added, the system is solved again until that set stops changing.
+void step(const Operator& op, int nodes, double dt, double w, double boundary, const double* payoff, double* value, Scratch& scratch) {
+    std::vector<double>& rhs = scratch.rhs;
+    std::vector<double>& factor = scratch.factor;
+    std::vector<double>& x = scratch.solution;
+    rhs.resize(nodes);
+    factor.resize(nodes);
+    x.resize(nodes);
+
+    const double explicitDt = (1.0 - w) * dt, implicitDt = w * dt;
+    rhs[0] = value[0] * (1.0 + explicitDt * op.diag[0]);
+    for (int i = 1; i < nodes - 1; ++i)
+        rhs[i] = value[i] + explicitDt * (op.lower[i] * value[i - 1] + op.diag[i] * value[i] + op.upper[i] * value[i + 1]);
+    rhs[nodes - 1] = boundary;
+
+    std::vector<char>& exercised = scratch.exercised;
+    exercised.assign(nodes, 0);
+    if (payoff) {
+        for (int i = 0; i < nodes - 1; ++i)
+            exercised[i] = value[i] < payoff[i];
+    }
+
+    for (int iteration = 0; iteration < (payoff ? Pde::PENALTY_ITERATIONS : 1); ++iteration) {
+        // Thomas algorithm, factor holds the eliminated upper diagonal and x the eliminated right-hand side
+        double pivot = 1.0 - implicitDt * op.diag[0] + (exercised[0] ? PENALTY : 0.0);
+        factor[0] = -implicitDt * op.upper[0] / pivot;
+        x[0] = (rhs[0] + (exercised[0] ? PENALTY * payoff[0] : 0.0)) / pivot;
+        for (int i = 1; i < nodes - 1; ++i) {
+            const double sub = -implicitDt * op.lower[i];
+            pivot = 1.0 - implicitDt * op.diag[i] + (exercised[i] ? PENALTY : 0.0) - sub * factor[i - 1];
+            factor[i] = -implicitDt * op.upper[i] / pivot;
+            x[i] = (rhs[i] + (exercised[i] ? PENALTY * payoff[i] : 0.0) - sub * x[i - 1]) / pivot;
+        }
+        x[nodes - 1] = boundary;
+        for (int i = nodes - 2; i >= 0; --i)
+            x[i] -= factor[i] * x[i + 1];
+
+        bool changed = false;
+        if (payoff) {
+            for (int i = 0; i < nodes - 1; ++i) {
+                const char below = x[i] < payoff[i];
+                changed = changed || below != exercised[i];
+                exercised[i] = below;
+            }
+        }
+        if (!changed)
+            break;
+    }
+    std::copy(x.begin(), x.end(), value);
+}
+
+bool positive(double x) {
+    return x > 0 && std::isfinite(x);
+}
+
+} // namespace
+
+void Pde::solve(bool put, const double* S, int countS, const double* T, int countT, double K, double r, double q, double sigma, const Settings& settings, Greeks* out) {
+    std::fill(out, out + static_cast<long long>(countS) * countT, Greeks{ NAN, NAN, NAN, NAN });
+    if (!positive(K) || !positive(sigma) || !std::isfinite(r) || !std::isfinite(q) || settings.spaceSteps < 8 || settings.timeSteps < 4)
+        return;
+
+    // Expiries in the order the march reaches them
+    std::vector<int> order;
+    for (int t = 0; t < countT; ++t) {
+        if (positive(T[t]))
+            order.push_back(t);
+    }
+    std::sort(order.begin(), order.end(), [T](int a, int b) { return T[a] < T[b]; });
+    double sMax = 0;
+    for (int i = 0; i < countS; ++i) {
+        if (positive(S[i]))
+            sMax = std::max(sMax, S[i]);
+    }
+    if (order.empty() || sMax == 0)
+        return;
+    const double tMax = T[order.back()];
+
+    const int nodes = settings.spaceSteps + 1;
+    const double far = std::max(sMax, K) * std::exp(FAR_FIELD * sigma * std::sqrt(tMax));
+    thread_local std::vector<double> s, value, payoff, delta, gamma, theta;
+    thread_local Operator op;
+    thread_local Scratch scratch;
+    s.resize(nodes);
+    buildNodes(K, far, nodes, s.data());
+    op.build(s.data(), nodes, r, q, sigma);
+
+    payoff.resize(nodes);
+    for (int i = 0; i < nodes; ++i)
+        payoff[i] = std::max(put ? K - s[i] : s[i] - K, 0.0);
+    value = payoff;
+    delta.resize(nodes);
+    gamma.resize(nodes);
+    theta.resize(nodes);
+
+    // Far field: a put is worthless, a call is its forward less the discounted strike (exercised if that is less)
+    auto boundary = [&](double tau) {
+        if (put)
+            return 0.0;
+        const double european = far * std::exp(-q * tau) - K * std::exp(-r * tau);
+        return settings.american ? std::max(european, far - K) : european;
+    };
+
+    // Steps evenly spaced in sqrt(tau), short where the payoff kink is still sharp, and landing on every T
+    const double rootStep = std::sqrt(tMax) / settings.timeSteps;
+    const double* constraint = settings.american ? payoff.data() : nullptr;
+    double tau = 0;
+    int taken = 0;
+    for (int t : order) {
+        const double from = std::sqrt(tau), to = std::sqrt(T[t]);
+        const int steps = to > from ? std::max(1, static_cast<int>(std::ceil((to - from) / rootStep - 1e-9))) : 0;
+        for (int k = 1; k <= steps; ++k, ++taken) {
+            const double root = from + (to - from) * k / steps;
+            const double next = k == steps ? T[t] : root * root;
+            const double dt = next - tau;
+            if (taken < RANNACHER_STEPS) {
+                step(op, nodes, 0.5 * dt, 1.0, boundary(tau + 0.5 * dt), constraint, value.data(), scratch);
+                step(op, nodes, 0.5 * dt, 1.0, boundary(next), constraint, value.data(), scratch);
+            } else {
+                step(op, nodes, dt, 0.5, boundary(next), constraint, value.data(), scratch);
+            }
+            tau = next;
+        }
+        tau = T[t];
+
+        // Node Greeks from the three point differences of the non-uniform grid. Theta is -L V where the option is
+        // held and 0 where it is exercised, the PDE holds only in the former.
+        for (int i = 1; i < nodes - 1; ++i) {
+            const double hm = s[i] - s[i - 1], hp = s[i + 1] - s[i];
+            delta[i] = (-hp * hp * value[i - 1] + (hp * hp - hm * hm) * value[i] + hm * hm * value[i + 1]) / (hm * hp * (hm + hp));
+            gamma[i] = 2.0 * (hm * value[i + 1] - (hm + hp) * value[i] + hp * value[i - 1]) / (hm * hp * (hm + hp));
+            const bool exercised = settings.american && value[i] <= payoff[i] + EXERCISED * K;
+            theta[i] = exercised ? 0.0 : -(op.lower[i] * value[i - 1] + op.diag[i] * value[i] + op.upper[i] * value[i + 1]);
+        }
+
+        // Taylor from the nearest node for price and delta, gamma and theta linear between the two around S
+        for (int i = 0; i < countS; ++i) {
+            if (!positive(S[i]))
+                continue;
+            const int j = std::min(std::max(static_cast<int>(std::upper_bound(s.begin(), s.end(), S[i]) - s.begin()) - 1, 1), nodes - 3);
+            const double weight = (S[i] - s[j]) / (s[j + 1] - s[j]);
+            const int nearest = weight < 0.5 ? j : j + 1;
+            const double d = S[i] - s[nearest];
+            Greeks& g = out[static_cast<long long>(t) * countS + i];
+            g.price = value[nearest] + d * (delta[nearest] + 0.5 * d * gamma[nearest]);
+            g.delta = delta[nearest] + d * gamma[nearest];
+            g.gamma = gamma[j] + weight * (gamma[j + 1] - gamma[j]);
+            g.theta = theta[j] + weight * (theta[j + 1] - theta[j]);
+            if (settings.american)
+                g.price = std::max(g.price, std::max(put ? K - S[i] : S[i] - K, 0.0));
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PDE_H
+#define PDE_H
+
+// Crank-Nicolson finite differences for the Black-Scholes PDE of Functions in S and time to expiry. One solve
+// marches from expiry to the longest T and reads off every S at every T on the way, O(nodes * time steps).
+class Pde
+{
+public:
+    Pde();
+
+    struct Settings {
+        bool american; // Exercisable at every time step, by penalty iteration
+        int spaceSteps; // Nodes in S from 0 to the far field, sinh-spaced and densest around K
+        int timeSteps; // Steps up to the longest T, evenly spaced in sqrt(T), more if the T asked for are closer together
+    };
+
+    // Price and the Greeks at one (S, T), theta per year
+    struct Greeks {
+        double price;
+        double delta;
+        double gamma;
+        double theta;
+    };
+
+    static constexpr int SPACE_STEPS = 400; // Suggested Settings::spaceSteps
+    static constexpr int TIME_STEPS = 200; // Suggested Settings::timeSteps
+    static constexpr double CLUSTER = 0.1; // Nodes are densest within about CLUSTER K of K
+    static constexpr double FAR_FIELD = 6.0; // Standard deviations over the longest T between the highest S and the last node
+    static constexpr int RANNACHER_STEPS = 2; // First time steps taken as two implicit Euler half steps, damps the kink of the payoff
+    static constexpr int PENALTY_ITERATIONS = 8; // Most linear solves per time step for early exercise
+
+    // out[t * countS + s] at S[s] and T[t], both in any order. NaN for invalid inputs, at T <= 0 and for fewer
+    // than 8 space or 4 time steps.
+    static void solve(bool put, const double* S, int countS, const double* T, int countT, double K, double r, double q, double sigma, const Settings& settings, Greeks* out);
+};
+
+#endif // PDE_H
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "threadpool.h"
+
+// Headless batch pricer. Reads one option per line as "S,K,r,q,sigma,T,type" (type C or P, rates and
+// volatility as decimals, T in years) and writes "price,delta,gamma,vega,theta,rho" for each, in order.
+// Input is streamed in fixed-size chunks, so memory stays bounded whatever the file size.
+
+namespace {
+
+constexpr size_t CHUNK_BYTES = 8u << 20; // Input read per step, the next chunk is read while this one is priced
+constexpr int BLOCK_LINES = 4096; // Lines per parallel task
+constexpr int INPUT_FIELDS = 6;
+constexpr int OUTPUT_FIELDS = 6;
+
+struct Chunk {
+    std::string text; // Whole lines only
+    bool last;
+};
+
+class Reader
+{
+public:
+    explicit Reader(FILE* in) : in(in) {}
+
+    Chunk next() {
+        Chunk chunk;
+        chunk.text.swap(carry);
+        while (true) {
+            const size_t have = chunk.text.size();
+            chunk.text.resize(have + CHUNK_BYTES);
+            const size_t got = std::fread(&chunk.text[have], 1, CHUNK_BYTES, in);
+            chunk.text.resize(have + got);
+            if (got < CHUNK_BYTES) { // End of input
+                chunk.last = true;
+                return chunk;
+            }
+
+            // Cut after the last full line, a line longer than a chunk keeps reading
+            const size_t end = chunk.text.rfind('\n');
+            if (end != std::string::npos) {
+                carry.assign(chunk.text, end + 1, std::string::npos);
+                chunk.text.resize(end + 1);
+                chunk.last = false;
+                return chunk;
+            }
+        }
+    }
+
+private:
+    FILE* in;
+    std::string carry; // Partial line left over from the previous chunk
+};
+
+void skipBlanks(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+}
+
+// One record, false if a field is missing, malformed or out of domain (non-finite, or S, K, sigma or T not
+// positive), or the type letter is followed by anything but blanks
+bool parseLine(const char* p, const char* end, double* values, bool& put) {
+    for (int i = 0; i < INPUT_FIELDS; ++i) {
+        skipBlanks(p, end);
+        const std::from_chars_result parsed = std::from_chars(p, end, values[i]);
+        if (parsed.ec != std::errc() || !std::isfinite(values[i]))
+            return false;
+        p = parsed.ptr;
+        skipBlanks(p, end);
+        if (p == end || *p++ != ',')
+            return false;
+    }
+    skipBlanks(p, end);
+    if (p == end)
+        return false;
+
+    const char type = static_cast<char>(std::toupper(static_cast<unsigned char>(*p++)));
+    skipBlanks(p, end);
+    if (p < end && *p == '\r')
+        ++p;
+    if (p < end && *p != '\n')
+        return false;
+
+    const double S = values[0], K = values[1], sigma = values[4], T = values[5];
+    put = type == 'P';
+    return (type == 'C' || type == 'P') && S > 0 && K > 0 && sigma > 0 && T > 0;
+}
+
+// A header starts with a field that is not a number, a data line that fails parseLine is still data
+bool isHeader(const char* p, const char* end) {
+    double value;
+    skipBlanks(p, end);
+    return std::from_chars(p, end, value).ec != std::errc();
+}
+
+// Per-thread buffers for one block, inputs and the Functions::BatchOutput arrays
+struct Scratch {
+    double in[INPUT_FIELDS][BLOCK_LINES];
+    double out[10][BLOCK_LINES];
+    bool put[BLOCK_LINES];
+    bool valid[BLOCK_LINES];
+};
+
+class Pricer
+{
+public:
+    Pricer(ThreadPool& pool, int precision) : pool(pool), precision(precision), invalid(0) {}
+
+    // Prices every line of text and writes the results to out in input order
+    void run(const std::string& text, FILE* out) {
+        lines.clear();
+        for (size_t begin = 0; begin < text.size();) {
+            const char* newline = static_cast<const char*>(std::memchr(text.data() + begin, '\n', text.size() - begin));
+            const size_t end = newline ? newline - text.data() : text.size();
+            if (text.find_first_not_of(" \t\r", begin) < end) // Skip blank lines
+                lines.push_back(begin);
+            begin = end + 1;
+        }
+
+        const int count = static_cast<int>(lines.size());
+        const int blocks = (count + BLOCK_LINES - 1) / BLOCK_LINES;
+        if (static_cast<int>(results.size()) < blocks)
+            results.resize(blocks);
+
+        std::atomic<unsigned long long> rejected(0);
+        pool.parallelFor(blocks, [&](int block) {
+            const int first = block * BLOCK_LINES;
+            const int n = std::min(BLOCK_LINES, count - first);
+            rejected += priceBlock(text, first, n, results[block]);
+        });
+        invalid += rejected;
+
+        for (int block = 0; block < blocks; ++block)
+            std::fwrite(results[block].data(), 1, results[block].size(), out);
+    }
+
+    unsigned long long invalidCount() const { return invalid; }
+
+private:
+    // Returns the number of malformed lines, which are written as nan
+    unsigned long long priceBlock(const std::string& text, int first, int n, std::string& result) {
+        thread_local std::unique_ptr<Scratch> scratch(new Scratch);
+        Scratch& s = *scratch;
+
+        unsigned long long rejected = 0;
+        for (int i = 0; i < n; ++i) {
+            double values[INPUT_FIELDS];
+            s.valid[i] = parseLine(text.data() + lines[first + i], text.data() + text.size(), values, s.put[i]);
+            if (!s.valid[i]) {
+                ++rejected;
+                const double placeholder[INPUT_FIELDS] = { 1, 1, 0, 0, 1, 1 }; // Keeps the batch kernel on finite inputs
+                std::copy(placeholder, placeholder + INPUT_FIELDS, values);
+            }
+            for (int f = 0; f < INPUT_FIELDS; ++f)
+                s.in[f][i] = values[f];
+        }
+
+        Functions::BatchInput in = { s.in[0], s.in[1], s.in[2], s.in[3], s.in[4], s.in[5] };
+        Functions::BatchOutput out;
+        out.callPrice = s.out[0]; out.putPrice = s.out[1];
+        out.callDelta = s.out[2]; out.putDelta = s.out[3];
+        out.gamma = s.out[4]; out.vega = s.out[5];
+        out.callTheta = s.out[6]; out.putTheta = s.out[7];
+        out.callRho = s.out[8]; out.putRho = s.out[9];
+        Functions::computeBatch(in, out, n);
+
+        result.clear();
+        char line[OUTPUT_FIELDS * 32];
+        for (int i = 0; i < n; ++i) {
+            if (!s.valid[i]) {
+                result += "nan,nan,nan,nan,nan,nan\n";
+                continue;
+            }
+            const int p = s.put[i] ? 1 : 0; // Put columns follow call columns in s.out
+            const double fields[OUTPUT_FIELDS] = { s.out[0 + p][i], s.out[2 + p][i], s.out[4][i], s.out[5][i], s.out[6 + p][i], s.out[8 + p][i] };
+
+            char* cursor = line;
+            for (int f = 0; f < OUTPUT_FIELDS; ++f) {
+                cursor = std::to_chars(cursor, line + sizeof(line) - 1, fields[f], std::chars_format::general, precision).ptr;
+                *cursor++ = f + 1 < OUTPUT_FIELDS ? ',' : '\n';
+            }
+            result.append(line, cursor - line);
+        }
+        return rejected;
+    }
+
+    ThreadPool& pool;
+    int precision; // Significant digits written
+    std::vector<size_t> lines; // Offset of each non-blank line in the current chunk
+    std::vector<std::string> results; // Output text per block, capacity reused across chunks
+    unsigned long long invalid;
+};
+
+void usage(const char* name) {
+    std::fprintf(stderr,
+                 "Usage: %s [-o output.csv] [-j threads] [-p digits] [input.csv]\n"
+                 "Reads S,K,r,q,sigma,T,type (C or P) per line from input.csv or stdin,\n"
+                 "writes price,delta,gamma,vega,theta,rho per line to output.csv or stdout.\n"
+                 "r, q and sigma are decimals, T is in years. A first line whose first field is not a number is taken\n"
+                 "as a header. Malformed lines, or lines with non-finite values or S, K, sigma or T not positive, are\n"
+                 "written as nan and counted.\n",
+                 name);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* inputPath = nullptr;
+    const char* outputPath = nullptr;
+    int threads = 0;
+    int precision = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "-o" || arg == "-j" || arg == "-p") && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (arg == "-o") outputPath = value;
+            if (arg == "-j") threads = std::atoi(value);
+            if (arg == "-p") precision = std::max(1, std::min(17, std::atoi(value)));
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (!inputPath && arg[0] != '-') {
+            inputPath = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    FILE* in = inputPath ? std::fopen(inputPath, "rb") : stdin;
+    if (!in) {
+        std::perror(inputPath);
+        return 1;
+    }
+    FILE* out = outputPath ? std::fopen(outputPath, "wb") : stdout;
+    if (!out) {
+        std::perror(outputPath);
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    Pricer pricer(pool, precision);
+    Reader reader(in);
+
+    Chunk chunk = reader.next();
+
+    // Header line
+    const size_t firstLine = chunk.text.find_first_not_of(" \t\r\n");
+    if (firstLine != std::string::npos && isHeader(chunk.text.data() + firstLine, chunk.text.data() + chunk.text.size())) {
+        const size_t end = chunk.text.find('\n', firstLine);
+        chunk.text.erase(0, end == std::string::npos ? chunk.text.size() : end + 1);
+        std::fputs("price,delta,gamma,vega,theta,rho\n", out);
+    }
+
+    while (true) {
+        std::future<Chunk> next;
+        if (!chunk.last)
+            next = std::async(std::launch::async, [&reader] { return reader.next(); });
+
+        pricer.run(chunk.text, out);
+
+        if (chunk.last)
+            break;
+        chunk = next.get();
+    }
+
+    const bool failed = std::ferror(in) || std::fflush(out) != 0 || std::ferror(out);
+    if (inputPath)
+        std::fclose(in);
+    if (outputPath)
+        std::fclose(out);
+
+    if (pricer.invalidCount())
+        std::fprintf(stderr, "%llu malformed lines written as nan\n", pricer.invalidCount());
+    if (failed) {
+        std::fprintf(stderr, "I/O error\n");
+        return 1;
+    }
+    return 0;
+}
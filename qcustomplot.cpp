@@ -24,6 +24,11 @@
 ****************************************************************************/
 
 #include "qcustomplot.h"
+#include "fastmath.h"
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
+#include <functional>
 
 
 /* including file 'src/vector2d.cpp'       */
@@ -16688,6 +16693,35 @@ void QCPColorGradient::setPeriodic(bool enabled)
   mPeriodic = enabled;
 }
 
+/*! \internal
+
+  Linear, non-periodic mapping of a contiguous row, the common case of \ref QCPColorGradient::colorize.
+  Branch-free so that it vectorizes (gathering from \a colors with AVX2/AVX-512 where available):
+  positions are clamped before truncation, which gives the same level as truncating then clamping,
+  and NaN cells select \a nanColor.
+*/
+BATCH_TARGETS
+static void colorizeLinearRow(const double *data, int n, double lower, double posToIndexFactor, const QRgb *colors, int levelCount, QRgb nanColor, QRgb *scanLine)
+{
+  // Levels and NaN masks of a chunk first, then the lookup, each loop vectorizes on its own
+  const int chunkSize = 256;
+  int levels[chunkSize];
+  QRgb nanMasks[chunkSize];
+  const double lastLevel = levelCount-1;
+  for (int begin=0; begin<n; begin+=chunkSize)
+  {
+    const int count = std::min(chunkSize, n-begin);
+    for (int i=0; i<count; ++i)
+    {
+      const double value = data[begin+i];
+      levels[i] = int(std::min(lastLevel, std::max(0.0, (value-lower)*posToIndexFactor))); // argument order sends NaN to 0
+      nanMasks[i] = QRgb(0)-QRgb(value != value);
+    }
+    for (int i=0; i<count; ++i)
+      scanLine[begin+i] = (colors[levels[i]] & ~nanMasks[i]) | (nanColor & nanMasks[i]); // blended rather than branched
+  }
+}
+
 /*! \overload
   
   This method is used to quickly convert a \a data array to colors. The colors will be output in
@@ -16724,6 +16758,20 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
   
   const bool skipNanCheck = mNanHandling == nhNone;
   const double posToIndexFactor = !logarithmic ? (mLevelCount-1)/range.size() : (mLevelCount-1)/qLn(range.upper/range.lower);
+  if (!logarithmic && !mPeriodic && dataIndexFactor == 1)
+  {
+    QRgb nanColor = mColorBuffer.first(); // nhNone leaves NaN undefined, any color will do
+    switch(mNanHandling)
+    {
+    case nhLowestColor: nanColor = mColorBuffer.first(); break;
+    case nhHighestColor: nanColor = mColorBuffer.last(); break;
+    case nhTransparent: nanColor = qRgba(0, 0, 0, 0); break;
+    case nhNanColor: nanColor = mNanColor.rgba(); break;
+    case nhNone: break;
+    }
+    colorizeLinearRow(data, n, range.lower, posToIndexFactor, mColorBuffer.constData(), mLevelCount, nanColor, scanLine);
+    return;
+  }
   for (int i=0; i<n; ++i)
   {
     const double value = data[dataIndexFactor*i];
@@ -25861,7 +25909,7 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize, const QCPRange &key
 
 QCPColorMapData::~QCPColorMapData()
 {
-  delete[] mData;
+  releaseData();
   delete[] mAlpha;
 }
 
@@ -25897,6 +25945,7 @@ QCPColorMapData &QCPColorMapData::operator=(const QCPColorMapData &other)
     setRange(other.keyRange(), other.valueRange());
     if (!isEmpty())
     {
+      detachData();
       memcpy(mData, other.mData, sizeof(mData[0])*size_t(keySize*valueSize));
       if (mAlpha)
         memcpy(mAlpha, other.mAlpha, sizeof(mAlpha[0])*size_t(keySize*valueSize));
@@ -25961,7 +26010,7 @@ void QCPColorMapData::setSize(int keySize, int valueSize)
   {
     mKeySize = keySize;
     mValueSize = valueSize;
-    delete[] mData;
+    releaseData();
     mIsEmpty = mKeySize == 0 || mValueSize == 0;
     if (!mIsEmpty)
     {
@@ -26080,6 +26129,7 @@ void QCPColorMapData::setData(double key, double value, double z)
   int valueCell = int( (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5 );
   if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
   {
+    detachData();
     mData[valueCell*mKeySize + keyCell] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
@@ -26104,6 +26154,7 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
 {
   if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
   {
+    detachData();
     mData[valueIndex*mKeySize + keyIndex] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
@@ -26142,6 +26193,37 @@ void QCPColorMapData::setAlpha(int keyIndex, int valueIndex, unsigned char alpha
     qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
 }
 
+/*!
+  Replaces the cells with the \a keySize * \a valueSize values at \a data, stored row by row like
+  the internal array (value index major). The buffer is shared rather than copied and kept alive
+  through \a data until the next call that writes a cell (\ref setCell, \ref setData, \ref fill),
+  which first copies it. \a dataBounds is taken as the data minimum and maximum without going
+  through the cells, so it must be known to the caller.
+
+  An existing alpha map is recreated at the new size if the size changes.
+
+  \see setSize, recalculateDataBounds
+*/
+void QCPColorMapData::setSharedData(int keySize, int valueSize, std::shared_ptr<const double> data, const QCPRange &dataBounds)
+{
+  if (!data)
+    keySize = valueSize = 0;
+  const bool resized = keySize != mKeySize || valueSize != mValueSize;
+  releaseData();
+  mKeySize = keySize;
+  mValueSize = valueSize;
+  mIsEmpty = mKeySize == 0 || mValueSize == 0;
+  if (!mIsEmpty)
+  {
+    mSharedData = std::move(data);
+    mData = const_cast<double*>(mSharedData.get()); // only read while shared, see detachData
+  }
+  if (mAlpha && resized)
+    createAlpha();
+  mDataBounds = dataBounds;
+  mDataModified = true;
+}
+
 /*!
   Goes through the data and updates the buffered minimum and maximum data values.
   
@@ -26202,6 +26284,7 @@ void QCPColorMapData::clearAlpha()
 */
 void QCPColorMapData::fill(double z)
 {
+  detachData();
   const int dataCount = mValueSize*mKeySize;
   memset(mData, z, dataCount*sizeof(*mData));
   mDataBounds = QCPRange(z, z);
@@ -26313,6 +26396,45 @@ bool QCPColorMapData::createAlpha(bool initializeOpaque)
   }
 }
 
+/*! \internal
+
+  Frees the data array, or drops the reference if it is shared (see \ref setSharedData).
+*/
+void QCPColorMapData::releaseData()
+{
+  if (mSharedData)
+    mSharedData.reset();
+  else
+    delete[] mData;
+  mData = nullptr;
+}
+
+/*! \internal
+
+  Gives this instance its own copy of shared data before a cell is written. Does nothing if the data
+  is not shared.
+*/
+void QCPColorMapData::detachData()
+{
+  if (!mSharedData)
+    return;
+  const size_t dataCount = size_t(mKeySize*mValueSize);
+  double *data = nullptr;
+#ifdef __EXCEPTIONS
+  try {
+#endif
+    data = new double[dataCount];
+#ifdef __EXCEPTIONS
+  } catch (...) { data = nullptr; }
+#endif
+  if (data)
+    memcpy(data, mSharedData.get(), dataCount*sizeof(*data));
+  else
+    qDebug() << Q_FUNC_INFO << "out of memory for data dimensions "<< mKeySize << "*" << mValueSize;
+  mSharedData.reset();
+  mData = data;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPColorMap
@@ -26790,31 +26912,54 @@ void QCPColorMap::updateMapImage()
     
     const double *rawData = mMapData->mData;
     const unsigned char *rawAlpha = mMapData->mAlpha;
-    if (keyAxis->orientation() == Qt::Horizontal)
-    {
-      const int lineCount = valueSize;
-      const int rowCount = keySize;
-      for (int line=0; line<lineCount; ++line)
-      {
-        QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
-        if (rawAlpha)
-          mGradient.colorize(rawData+line*rowCount, rawAlpha+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-        else
-          mGradient.colorize(rawData+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-      }
-    } else // keyAxis->orientation() == Qt::Vertical
-    {
-      const int lineCount = keySize;
-      const int rowCount = valueSize;
-      for (int line=0; line<lineCount; ++line)
+    const bool logarithmic = mDataScaleType==QCPAxis::stLogarithmic;
+    const bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+    const int lineCount = horizontal ? valueSize : keySize;
+    const int rowCount = horizontal ? keySize : valueSize;
+    uchar *bits = localMapImage->bits(); // detaches once here, the lines below may be written from several threads
+    const qint64 bytesPerLine = localMapImage->bytesPerLine();
+    const std::function<void(int, int)> colorizeLines = [&](int begin, int end)
+    {
+      for (int line=begin; line<end; ++line)
       {
-        QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+        QRgb* pixels = reinterpret_cast<QRgb*>(bits + bytesPerLine*(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+        const int offset = horizontal ? line*rowCount : line;
+        const int dataIndexFactor = horizontal ? 1 : lineCount;
         if (rawAlpha)
-          mGradient.colorize(rawData+line, rawAlpha+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
+          mGradient.colorize(rawData+offset, rawAlpha+offset, mDataRange, pixels, rowCount, dataIndexFactor, logarithmic);
         else
-          mGradient.colorize(rawData+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
+          mGradient.colorize(rawData+offset, mDataRange, pixels, rowCount, dataIndexFactor, logarithmic);
       }
-    }
+    };
+    
+    // Large maps are split into chunks of lines on a pool of their own, so long tasks on the global pool can't
+    // hold up the repaint waiting here. The chunks are QRunnables, QThreadPool::start(callable) needs Qt 5.15.
+    // The first line runs alone, which also brings the gradient's color buffer up to date before it is shared.
+    class ColorizeChunk : public QRunnable
+    {
+    public:
+      ColorizeChunk(const std::function<void(int, int)> &colorize, QSemaphore &finished, int begin, int end) :
+        mColorize(colorize), mFinished(finished), mBegin(begin), mEnd(end) {}
+      void run() Q_DECL_OVERRIDE { mColorize(mBegin, mEnd); mFinished.release(); }
+    private:
+      const std::function<void(int, int)> &mColorize;
+      QSemaphore &mFinished;
+      const int mBegin, mEnd;
+    };
+    static QThreadPool colorizePool;
+    const int minChunkLines = 16;
+    const qint64 minParallelCells = 256*256;
+    colorizeLines(0, qMin(1, lineCount));
+    const int chunks = qBound(1, qMin(colorizePool.maxThreadCount(), lineCount/minChunkLines), lineCount-1);
+    if (chunks > 1 && qint64(lineCount)*rowCount >= minParallelCells)
+    {
+      QSemaphore finished;
+      for (int chunk=1; chunk<chunks; ++chunk)
+        colorizePool.start(new ColorizeChunk(colorizeLines, finished, 1+int(qint64(lineCount-1)*chunk/chunks), 1+int(qint64(lineCount-1)*(chunk+1)/chunks)));
+      colorizeLines(1, 1+(lineCount-1)/chunks);
+      finished.acquire(chunks-1);
+    } else
+      colorizeLines(1, lineCount);
     
     if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1)
     {
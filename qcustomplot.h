@@ -69,6 +69,7 @@
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
+#include <memory>
 #ifdef QCP_OPENGL_FBO
 #  include <QtGui/QOpenGLContext>
 #  if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -6047,6 +6048,7 @@ public:
   void setData(double key, double value, double z);
   void setCell(int keyIndex, int valueIndex, double z);
   void setAlpha(int keyIndex, int valueIndex, unsigned char alpha);
+  void setSharedData(int keySize, int valueSize, std::shared_ptr<const double> data, const QCPRange &dataBounds);
   
   // non-property methods:
   void recalculateDataBounds();
@@ -6066,11 +6068,14 @@ protected:
   
   // non-property members:
   double *mData;
+  std::shared_ptr<const double> mSharedData; // set by setSharedData, mData then points into it until the next write
   unsigned char *mAlpha;
   QCPRange mDataBounds;
   bool mDataModified;
   
   bool createAlpha(bool initializeOpaque=true);
+  void releaseData();
+  void detachData();
   
   friend class QCPColorMap;
 };
@@ -144,6 +144,7 @@ void RangeSlider::mousePressEvent(QMouseEvent* event)
             m_activeHandle = UpperHandle;
     }
 
+    setSliderDown(true);
 }
 
 void RangeSlider::mouseMoveEvent(QMouseEvent* event)
@@ -161,6 +162,12 @@ void RangeSlider::mouseMoveEvent(QMouseEvent* event)
         setUpperValue(value);
 }
 
+void RangeSlider::mouseReleaseEvent(QMouseEvent*)
+{
+    m_activeHandle = NoHandle;
+    setSliderDown(false);
+}
+
 int RangeSlider::pixelPosToRangeValue(int pos) const
 {
     QStyleOptionSlider option;
@@ -1,8 +1,75 @@
 #include "surface.h"
 #include "functions.h"
+#include "heston.h"
+#include "lattice.h"
+#include "pde.h"
+#include "threadpool.h"
+#include <cmath>
+#include <vector>
 
 Surface::Surface() {}
 
+namespace {
+
+// Closed-form surfaces: the value plotted picked out of one fused Greeks row
+template <char Z>
+double closedFormCell(Surface::OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
+    return Surface::selectZ(Z, mode, Functions::computeGreeks(S, K, r, q, sigma, T));
+}
+
+// American surfaces: one CRR lattice per cell, or one PDE solve for the whole surface
+template <double Lattice::Greeks::*Z>
+double americanCell(Surface::OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
+    return Lattice::american(mode == Surface::OptionMode::PUT, S, K, r, q, sigma, T).*Z;
+}
+
+// x is T, y is S
+template <double Pde::Greeks::*Z>
+void americanSurface(Surface::OptionMode mode, const double* T, int countT, const double* S, int countS, const double* params, double* z) {
+    const int count = countS * countT;
+    thread_local std::vector<Pde::Greeks> greeks;
+    greeks.resize(count);
+    Pde::solve(mode == Surface::OptionMode::PUT, S, countS, T, countT, params[1], params[2], params[3], params[4], { true, Pde::SPACE_STEPS, Pde::TIME_STEPS }, greeks.data());
+    for (int i = 0; i < count; ++i)
+        z[i] = greeks[i].*Z;
+}
+
+// Heston surfaces: sigma is the initial and the long-run volatility, the rest a typical equity index skew
+constexpr double HESTON_KAPPA = 2.0;
+constexpr double HESTON_XI = 0.5;
+constexpr double HESTON_RHO = -0.7;
+
+Heston::Model hestonModel(double sigma) {
+    return { sigma * sigma, HESTON_KAPPA, sigma * sigma, HESTON_XI, HESTON_RHO };
+}
+
+double hestonCell(Surface::OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
+    return Heston::price(mode == Surface::OptionMode::PUT, S, K, r, q, T, hestonModel(sigma));
+}
+
+// x is T, y is K: one strike strip per expiry, the expiries in parallel
+void hestonSurface(Surface::OptionMode mode, const double* T, int countT, const double* K, int countK, const double* params, double* z) {
+    const Heston::Model model = hestonModel(params[4]);
+    ThreadPool::instance().parallelFor(countT, [&](int t) {
+        Heston::strip(mode == Surface::OptionMode::PUT, params[0], K, countK, params[2], params[3], T[t], model, z + static_cast<size_t>(t) * countK);
+    });
+}
+
+} // namespace
+
+double Surface::selectZ(char zVal, OptionMode mode, const Functions::Greeks& greeks) {
+    const bool put = mode == OptionMode::PUT;
+    switch (zVal) {
+    case 'P': return put ? greeks.putPrice : greeks.callPrice;
+    case 'D': return put ? greeks.putDelta : greeks.callDelta;
+    case 'G': return greeks.gamma;
+    case 'V': return greeks.vega;
+    case 'H': return put ? greeks.putTheta : greeks.callTheta;
+    case 'O': return put ? greeks.putRho : greeks.callRho;
+    default: return NAN;
+    }
+}
+
 std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfaceMap = {
 
     {
@@ -17,11 +84,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::SINGLE,
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutPrice(S, K, r, q, sigma, T)
-                           : Functions::computeCallPrice(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'P'>,
+            nullptr
         }
     },
 
@@ -29,7 +93,7 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
         Surface::SurfaceMode::SIP, // (S,σ) -> Price
         {
             'I', 'S', 'P',
-                "Volatility (\u03C3)", "Stock Price (S)", "Option Price",
+                u8"Volatility (\u03C3)", "Stock Price (S)", "Option Price",
                 Surface::InputType::RANGE, // Stock Price
                 Surface::InputType::SINGLE,
                 Surface::InputType::SINGLE,
@@ -37,11 +101,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
                 Surface::InputType::RANGE, // Volatility
                 Surface::InputType::SINGLE,
 
-                [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                    return mode == OptionMode::PUT
-                               ? Functions::computePutPrice(S, K, r, q, sigma, T)
-                               : Functions::computeCallPrice(S, K, r, q, sigma, T);
-                }
+                closedFormCell<'P'>,
+                nullptr
         }
     },
 
@@ -57,11 +118,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutPrice(S, K, r, q, sigma, T)
-                           : Functions::computeCallPrice(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'P'>,
+            nullptr
         }
     },
 
@@ -69,7 +127,7 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
         Surface::SurfaceMode::SID, // (S,σ) -> Delta
         {
             'I', 'S', 'D',
-            "Volatility (\u03C3)", "Stock Price (S)", "Delta",
+            u8"Volatility (\u03C3)", "Stock Price (S)", "Delta",
             Surface::InputType::RANGE, // Stock Price
             Surface::InputType::SINGLE,
             Surface::InputType::SINGLE,
@@ -77,11 +135,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::RANGE, // Volatility
             Surface::InputType::SINGLE,
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutDelta(S, K, r, q, sigma, T)
-                           : Functions::computeCallDelta(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'D'>,
+            nullptr
         }
     },
 
@@ -97,11 +152,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutDelta(S, K, r, q, sigma, T)
-                           : Functions::computeCallDelta(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'D'>,
+            nullptr
         }
     },
 
@@ -117,9 +169,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return Functions::computeGamma(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'G'>,
+            nullptr
         }
     },
 
@@ -135,9 +186,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return Functions::computeVega(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'V'>,
+            nullptr
         }
     },
 
@@ -153,11 +203,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutTheta(S, K, r, q, sigma, T)
-                           : Functions::computeCallTheta(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'H'>,
+            nullptr
         }
     },
 
@@ -173,11 +220,8 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
             Surface::InputType::SINGLE,
             Surface::InputType::RANGE, // Time
 
-            [] (OptionMode mode, double S, double K, double r, double q, double sigma, double T) {
-                return mode == OptionMode::PUT
-                           ? Functions::computePutRho(S, K, r, q, sigma, T)
-                           : Functions::computeCallRho(S, K, r, q, sigma, T);
-            }
+            closedFormCell<'O'>,
+            nullptr
         }
     },
 
@@ -197,7 +241,93 @@ std::unordered_map<Surface::SurfaceMode, Surface::SurfaceConfig> Surface::surfac
                 return mode == OptionMode::PUT
                         ? Functions::computePutIV(S, K, r, q, Functions::computePutPrice(S, K, r, q, sigma, T), T)
                            : Functions::computeCallIV(S, K, r, q, Functions::computeCallPrice(S, K, r, q, sigma, T), T);
-            }
+            },
+            nullptr
+        }
+    },
+
+    {
+        Surface::SurfaceMode::STAP, // (S,T) -> American Price
+        {
+            'T', 'S', 'P',
+            "Time to Expiry (T) (Years)", "Stock Price (S)", "American Option Price",
+            Surface::InputType::RANGE, // Stock Price
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Time
+
+            americanCell<&Lattice::Greeks::price>,
+            americanSurface<&Pde::Greeks::price>
+        }
+    },
+
+    {
+        Surface::SurfaceMode::STAD, // (S,T) -> American Delta
+        {
+            'T', 'S', 'D',
+            "Time to Expiry (T) (Years)", "Stock Price (S)", "American Delta",
+            Surface::InputType::RANGE, // Stock Price
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Time
+
+            americanCell<&Lattice::Greeks::delta>,
+            americanSurface<&Pde::Greeks::delta>
+        }
+    },
+
+    {
+        Surface::SurfaceMode::STAG, // (S,T) -> American Gamma
+        {
+            'T', 'S', 'G',
+            "Time to Expiry (T) (Years)", "Stock Price (S)", "American Gamma",
+            Surface::InputType::RANGE, // Stock Price
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Time
+
+            americanCell<&Lattice::Greeks::gamma>,
+            americanSurface<&Pde::Greeks::gamma>
+        }
+    },
+
+    {
+        Surface::SurfaceMode::STAH, // (S,T) -> American Theta
+        {
+            'T', 'S', 'H',
+            "Time to Expiry (T) (Years)", "Stock Price (S)", "American Theta",
+            Surface::InputType::RANGE, // Stock Price
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Time
+
+            americanCell<&Lattice::Greeks::theta>,
+            americanSurface<&Pde::Greeks::theta>
+        }
+    },
+
+    {
+        Surface::SurfaceMode::KTXP, // (K,T) -> Heston Price
+        {
+            'T', 'K', 'P',
+            "Time to Expiry (T) (Years)", "Strike Price (K)", "Heston Option Price",
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Strike Price
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::SINGLE,
+            Surface::InputType::RANGE, // Time
+
+            hestonCell,
+            hestonSurface
         }
     },
 };
@@ -1,13 +1,13 @@
 #ifndef SURFACE_H
 #define SURFACE_H
 
-#include <QObject>
-#include <QString>
+#include <functional>
+#include <unordered_map>
+#include "functions.h"
 
-class Surface : public QObject
+// Qt-free so the pricing core builds without the GUI
+class Surface
 {
-    Q_OBJECT
-
 public:
     Surface();
 
@@ -32,6 +32,8 @@ public:
          * H = Theta
          * O = Rho
          * M = Implied Volatility
+         * A = American exercise (lattice per cell, PDE per surface), before the plotted quantity
+         * X = Heston stochastic volatility (σ as the initial and long-run volatility), before the plotted quantity
          * */
 
         SKP, // (S,K) -> Price
@@ -50,6 +52,13 @@ public:
         STO, // (S,T) -> Rho
 
         STM, // (S,T) -> Implied Volatility
+
+        STAP, // (S,T) -> American Price
+        STAD, // (S,T) -> American Delta
+        STAG, // (S,T) -> American Gamma
+        STAH, // (S,T) -> American Theta
+
+        KTXP, // (K,T) -> Heston Price
     };
 
     enum class InputType {
@@ -63,9 +72,9 @@ public:
         char yVal;
         char zVal;
 
-        QString xLabel;
-        QString yLabel;
-        QString zLabel;
+        const char* xLabel; // UTF-8
+        const char* yLabel;
+        const char* zLabel;
 
         InputType input_S;
         InputType input_K;
@@ -75,9 +84,16 @@ public:
         InputType input_T;
 
         std::function<double(OptionMode mode, double S, double K, double r, double q, double sigma, double T)> computeZ;
+
+        // Optional, z[i * countY + j] at every x[i] and y[j] in one solve, params holds the other inputs (S, K, r, q,
+        // sigma, T). Much cheaper than countX * countY computeZ calls.
+        std::function<void(OptionMode mode, const double* x, int countX, const double* y, int countY, const double* params, double* z)> computeSurface;
     };
 
     static std::unordered_map<SurfaceMode, SurfaceConfig> surfaceMap;
+
+    // Picks the value a surface plots (SurfaceConfig::zVal) out of a fused Greeks row. NAN for 'M'.
+    static double selectZ(char zVal, OptionMode mode, const Functions::Greeks& greeks);
 };
 
 #endif // SURFACE_H
@@ -0,0 +1,98 @@
+#include "surfacecache.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+SurfaceCache::SurfaceCache(size_t budget) : m_budget(budget), m_size(0) {}
+
+bool SurfaceCache::Key::operator==(const Key& other) const {
+    return surfaceMode == other.surfaceMode && mode == other.mode
+           && std::equal(std::begin(params), std::end(params), std::begin(other.params))
+           && min_x == other.min_x && max_x == other.max_x
+           && min_y == other.min_y && max_y == other.max_y
+           && cdf == other.cdf && samples == other.samples && adaptive == other.adaptive
+           && single == other.single;
+}
+
+size_t SurfaceCache::KeyHash::operator()(const Key& key) const {
+    size_t seed = std::hash<int>()(static_cast<int>(key.surfaceMode) * 2 + static_cast<int>(key.mode));
+    auto combine = [&seed](size_t h) { seed ^= h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2); };
+    for (double p : key.params)
+        combine(std::hash<double>()(p));
+    combine(std::hash<double>()(key.min_x));
+    combine(std::hash<double>()(key.max_x));
+    combine(std::hash<double>()(key.min_y));
+    combine(std::hash<double>()(key.max_y));
+    combine(std::hash<int>()(((key.samples * 2 + key.adaptive) * 2 + key.single) * 4 + static_cast<int>(key.cdf)));
+    return seed;
+}
+
+SurfaceCache::Key SurfaceCache::keyOf(const Grid::Request& request) {
+    Key key;
+    key.surfaceMode = request.surfaceMode;
+    key.mode = request.mode;
+    std::copy(std::begin(request.params), std::end(request.params), key.params);
+    key.params[request.idx] = 0.0;
+    key.params[request.idy] = 0.0;
+    key.min_x = request.min_x;
+    key.max_x = request.max_x;
+    key.min_y = request.min_y;
+    key.max_y = request.max_y;
+    key.cdf = request.cdf;
+    key.samples = request.samples;
+    key.adaptive = request.adaptive;
+    key.single = request.single;
+    return key;
+}
+
+std::shared_ptr<const Grid::Result> SurfaceCache::find(const Key& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end())
+        return nullptr;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void SurfaceCache::insert(const Key& key, std::shared_ptr<const Grid::Result> result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        m_size -= bytesOf(*it->second->second);
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    m_size += bytesOf(*result);
+    entries.emplace_front(key, std::move(result));
+    index[key] = entries.begin();
+    evict();
+}
+
+void SurfaceCache::setBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    m_budget = budget;
+    evict();
+}
+
+size_t SurfaceCache::budget() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return m_budget;
+}
+
+size_t SurfaceCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return m_size;
+}
+
+size_t SurfaceCache::bytesOf(const Grid::Result& result) {
+    return result.z.size() * sizeof(double);
+}
+
+void SurfaceCache::evict() {
+    while (m_size > m_budget && !entries.empty()) {
+        m_size -= bytesOf(*entries.back().second);
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
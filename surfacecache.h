@@ -0,0 +1,58 @@
+#ifndef SURFACECACHE_H
+#define SURFACECACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "grid.h"
+
+// LRU cache of finished surfaces, keyed by everything that determines their values. Thread-safe.
+class SurfaceCache
+{
+public:
+    explicit SurfaceCache(size_t budget); // Bytes of surface data kept before evicting
+
+    struct Key {
+        Surface::SurfaceMode surfaceMode;
+        Surface::OptionMode mode;
+        double params[6]; // Swept entries are zeroed, only the fixed inputs matter
+        double min_x;
+        double max_x;
+        double min_y;
+        double max_y;
+        Functions::Cdf cdf;
+        int samples;
+        bool adaptive;
+        bool single;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    static Key keyOf(const Grid::Request& request);
+
+    std::shared_ptr<const Grid::Result> find(const Key& key); // nullptr on miss, marks a hit as most recent
+    void insert(const Key& key, std::shared_ptr<const Grid::Result> result);
+
+    void setBudget(size_t budget);
+    size_t budget() const;
+    size_t size() const; // Bytes currently held
+
+private:
+    using Entry = std::pair<Key, std::shared_ptr<const Grid::Result>>;
+
+    static size_t bytesOf(const Grid::Result& result);
+    void evict(); // Drops least recently used entries until within budget
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // Most recent first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    size_t m_budget;
+    size_t m_size;
+};
+
+#endif // SURFACECACHE_H
@@ -0,0 +1,144 @@
+#include "threadpool.h"
+#include <algorithm>
+
+// The pool whose task the current thread is running, if any
+static thread_local const ThreadPool* runningPool = nullptr;
+
+static uint64_t packRange(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+ThreadPool::ThreadPool(int threads) :
+    task(nullptr), epoch(0), active(0), stopping(false)
+{
+    if (threads <= 0)
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    ranges.reset(new std::atomic<uint64_t>[threads]);
+    for (int i = 0; i < threads; ++i)
+        ranges[i].store(0);
+
+    // Slot 0 is the calling thread
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+    if (count <= 0)
+        return;
+
+    // Called from one of our own tasks: every participant is already busy, and jobMutex is held
+    if (runningPool == this) {
+        for (int i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+
+    const int n = size();
+    for (int i = 0; i < n; ++i) {
+        const uint32_t begin = static_cast<uint32_t>(static_cast<long long>(count) * i / n);
+        const uint32_t end = static_cast<uint32_t>(static_cast<long long>(count) * (i + 1) / n);
+        ranges[i].store(packRange(begin, end));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        active = n - 1;
+        ++epoch;
+    }
+    wake.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return active == 0; });
+    this->task = nullptr;
+}
+
+void ThreadPool::workerLoop(int slot) {
+    unsigned long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return stopping || epoch != seen; });
+            if (stopping)
+                return;
+            seen = epoch;
+        }
+
+        run(slot);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --active;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::run(int slot) {
+    const ThreadPool* outer = runningPool;
+    runningPool = this;
+    int index;
+    while (true) {
+        if (pop(slot, index))
+            (*task)(index);
+        else if (!steal(slot))
+            break;
+    }
+    runningPool = outer;
+}
+
+bool ThreadPool::pop(int slot, int& index) {
+    uint64_t range = ranges[slot].load();
+    while (true) {
+        const uint32_t begin = static_cast<uint32_t>(range >> 32);
+        const uint32_t end = static_cast<uint32_t>(range);
+        if (begin >= end)
+            return false;
+        if (ranges[slot].compare_exchange_weak(range, packRange(begin + 1, end))) {
+            index = static_cast<int>(begin);
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal(int slot) {
+    const int n = size();
+    for (int offset = 1; offset < n; ++offset) {
+        const int victim = (slot + offset) % n;
+        uint64_t range = ranges[victim].load();
+        while (true) {
+            const uint32_t begin = static_cast<uint32_t>(range >> 32);
+            const uint32_t end = static_cast<uint32_t>(range);
+            if (begin >= end)
+                break;
+
+            // Take the back half, the owner keeps popping from the front
+            const uint32_t mid = begin + (end - begin) / 2;
+            if (ranges[victim].compare_exchange_weak(range, packRange(begin, mid))) {
+                ranges[slot].store(packRange(mid, end));
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threads = 0); // 0 = one participant per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Shared pool used by the grid engine
+    static ThreadPool& instance();
+
+    // Participants including the calling thread
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Runs task(i) for every i in [0, count) and blocks until all are done.
+    // Indices are split evenly, idle participants steal half of a busy one's remaining range.
+    // Called from inside a task of the same pool, runs the loop inline on the calling thread.
+    void parallelFor(int count, const std::function<void(int)>& task);
+
+private:
+    void workerLoop(int slot);
+    void run(int slot);
+    bool pop(int slot, int& index);
+    bool steal(int slot);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<std::atomic<uint64_t>[]> ranges; // Per slot, begin << 32 | end
+
+    std::mutex jobMutex; // One parallelFor at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* task;
+    unsigned long long epoch;
+    int active;
+    bool stopping;
+};
+
+#endif // THREADPOOL_H